@@ -3,7 +3,15 @@
 
 #include "kbasket.hpp"
 #include "llic.hpp"
+#include <atomic>
+#include <cassert>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
 #include <iostream>
+#include <span>
+#include <thread>
+#include <utility>
 
 
 // - CAS
@@ -95,6 +103,8 @@ public:
     FAIQueue(int capacity, int k, int numProcesses);
     void enqueue(int x, int process);
     int dequeue(int process);
+    void enqueue_bulk(std::span<const int> xs, int process);
+    int dequeue_bulk(std::span<int> xs, int max, int process);
     ~FAIQueue();
 };
 
@@ -144,6 +154,46 @@ int FAIQueue<T>::dequeue(int process) {
     }
 }
 
+// Each basket receives the longest prefix of xs that fits in it, so
+// one fetch&add reserves up to k items.
+template<class T>
+void FAIQueue<T>::enqueue_bulk(std::span<const int> xs, int process) {
+    int tail;
+    while (!xs.empty()) {
+        tail = TAIL.LL();
+        xs = xs.subspan(A[tail].put_bulk(xs));
+        TAIL.IC(tail, process);
+    }
+}
+
+// Takes up to max items, basket by basket. Returns the number of
+// items taken, 0 if the queue is empty.
+template<class T>
+int FAIQueue<T>::dequeue_bulk(std::span<int> xs, int max, int process) {
+    xs = xs.first(std::min((int) xs.size(), max));
+    int taken = 0;
+    int head = HEAD.LL();
+    int tail = TAIL.LL();
+    while (taken < (int) xs.size()) {
+        if (head < tail) {
+            int n = A[head].take_bulk(xs.subspan(taken));
+            if (n != BASKET_CLOSED) {
+                taken += n;
+                continue;
+            }
+            HEAD.IC(head, process);
+        }
+        auto hhead = HEAD.LL();
+        auto ttail = TAIL.LL();
+        if (hhead == head && ttail == tail) {
+            return taken;
+        }
+        head = hhead;
+        tail = ttail;
+    }
+    return taken;
+}
+
 template<class T>
 FAIQueue<T>::~FAIQueue() {
     delete[] A;
@@ -283,4 +333,561 @@ template<class T>
 FAIGQueue<T>::~FAIGQueue() {
     delete[] A;
 }
+// Unbounded storage for the basket queues. The index returned by the
+// LL/IC objects selects segment index / SEGMENT_SIZE, reached through
+// a two level directory (BLOCKS x BLOCK_SIZE segment pointers) whose
+// blocks and segments are allocated on demand. Block b takes the entry
+// b % BLOCKS, so the directory spans 2^31 indices from the oldest
+// segment not yet freed; an enqueue that reaches a block whose entry
+// still holds an older block waits for it to be freed.
+//
+// Reclamation is done by segments. Each process announces, once for
+// its enqueues and once for its dequeues, the segment it is working
+// on, and withdraws the announcement with release() when the
+// operation ends, so an idle process does not hold any segment. The
+// pointer to the last segment is kept between operations: when the
+// index is still inside it and the segment is not below the frontier
+// after announcing it again, the basket is reached without touching
+// the directory. When HEAD passes a segment, the frontier is raised
+// and the segments below the frontier and below every announcement
+// are freed by a single reclaimer. A process whose index is below the
+// frontier gets nullptr and must treat the basket as full (enqueue)
+// or closed (dequeue).
+//
+// Indices are uint64_t. The queues take them from their LL/IC
+// objects, so they are unbounded with LLICCAS64 and stop at 2^31
+// operations with the int ones.
+template<class Basket>
+class BasketSegments {
+public:
+    static const int SEGMENT_SIZE = 1024;
+    static const int BLOCK_SIZE = 1024;
+    static const int BLOCKS = 2048;
+    enum SIDE {ENQUEUER, DEQUEUER};
+private:
+    static const uint64_t NONE = UINT64_MAX;
+
+    struct alignas(64) Announcement {
+        std::atomic<uint64_t> segment{NONE};
+        uint64_t cachedSegment = NONE;
+        Basket* cached = nullptr;
+    };
+
+    struct Block {
+        const uint64_t number;
+        std::atomic<Basket*> segments[BLOCK_SIZE]{};
+
+        Block(uint64_t number) : number(number) {}
+    };
+
+    int basketSize; // k for KBasketFAI, n for NBasketCAS
+    int numProcesses;
+    Announcement* announcements;
+    std::atomic<Block*> directory[BLOCKS];
+    alignas(64) std::atomic<uint64_t> frontier{0}; // Segments below are retired
+    std::atomic<uint64_t> reclaimed{0};            // Segments below are freed
+    std::atomic<bool> reclaiming{false};
+
+    // Blocks are freed in order, and the caller has announced s above
+    // the frontier, so an empty entry is never a freed block of s
+    Basket* segment(uint64_t s) {
+        uint64_t number = s / BLOCK_SIZE;
+        std::atomic<Block*>& entry = directory[number % BLOCKS];
+        Block* block = entry.load();
+        while (block == nullptr || block->number != number) {
+            if (block == nullptr) {
+                Block* newBlock = new Block(number);
+                if (entry.compare_exchange_strong(block, newBlock)) {
+                    block = newBlock;
+                } else {
+                    delete newBlock;
+                }
+            } else {
+                std::this_thread::yield();
+                block = entry.load();
+            }
+        }
+        Basket* seg = block->segments[s % BLOCK_SIZE].load();
+        if (seg == nullptr) {
+            Basket* newSeg = new Basket[SEGMENT_SIZE];
+            for (int i = 0; i < SEGMENT_SIZE; i++) {
+                newSeg[i].initializeDefault(basketSize);
+            }
+            if (block->segments[s % BLOCK_SIZE].compare_exchange_strong(seg, newSeg)) {
+                seg = newSeg;
+            } else {
+                delete[] newSeg;
+            }
+        }
+        return seg;
+    }
+
+public:
+    BasketSegments(int basketSize, int numProcesses) : basketSize(basketSize),
+                                                       numProcesses(numProcesses) {
+        announcements = new Announcement[2 * numProcesses];
+        for (int i = 0; i < BLOCKS; i++) {
+            directory[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~BasketSegments() {
+        for (int b = 0; b < BLOCKS; b++) {
+            Block* block = directory[b].load();
+            if (block == nullptr) continue;
+            for (int s = 0; s < BLOCK_SIZE; s++) {
+                delete[] block->segments[s].load();
+            }
+            delete block;
+        }
+        delete[] announcements;
+    }
+
+    Basket* basket(uint64_t index, int process, SIDE side) {
+        uint64_t s = index / SEGMENT_SIZE;
+        Announcement& announcement = announcements[2 * process + side];
+        if (announcement.segment.load(std::memory_order_relaxed) != s) {
+            announcement.segment.store(s);
+            // The segment was never below the frontier, so the
+            // cached pointer (if it is the same) was not freed
+            if (s < frontier.load()) {
+                announcement.segment.store(NONE);
+                announcement.cachedSegment = NONE;
+                return nullptr;
+            }
+            if (s != announcement.cachedSegment) {
+                announcement.cached = segment(s);
+                announcement.cachedSegment = s;
+            }
+        }
+        return &announcement.cached[index % SEGMENT_SIZE];
+    }
+
+    // Called at the end of each operation of the process on side
+    void release(int process, SIDE side) {
+        announcements[2 * process + side].segment.store(NONE, std::memory_order_release);
+    }
+
+    // Called after HEAD has reached head
+    void reclaim(uint64_t head) {
+        if (head % SEGMENT_SIZE != 0) return;
+        bool busy = false;
+        if (!reclaiming.compare_exchange_strong(busy, true)) return;
+        if (head / SEGMENT_SIZE > frontier.load()) {
+            frontier.store(head / SEGMENT_SIZE);
+        }
+        uint64_t limit = frontier.load();
+        for (int i = 0; i < 2 * numProcesses; i++) {
+            limit = std::min(limit, announcements[i].segment.load());
+        }
+        uint64_t s = reclaimed.load();
+        for (; s < limit; s++) {
+            std::atomic<Block*>& entry = directory[(s / BLOCK_SIZE) % BLOCKS];
+            Block* block = entry.load();
+            delete[] block->segments[s % BLOCK_SIZE].exchange(nullptr);
+            if (s % BLOCK_SIZE == BLOCK_SIZE - 1) {
+                entry.store(nullptr);
+                delete block;
+            }
+        }
+        reclaimed.store(s);
+        reclaiming.store(false);
+    }
+};
+
+// Unbounded version of CASQueue. The baskets live in the segments of
+// BasketSegments instead of a preallocated array. Indices have the
+// type of the LL/IC object (see BasketSegments).
+template<class T>
+class SegmentedCASQueue {
+private:
+    using Index = decltype(std::declval<T&>().LL());
+
+    int numProcesses;
+    BasketSegments<NBasketCAS> segments;
+    T HEAD;
+    T TAIL;
+public:
+    SegmentedCASQueue(int numProcesses);
+    void enqueue(int x, int process);
+    int dequeue(int process);
+};
+
+template<class T>
+SegmentedCASQueue<T>::SegmentedCASQueue(int numProcesses) : numProcesses(numProcesses),
+                                                            segments(numProcesses, numProcesses) {
+    HEAD.initializeDefault(numProcesses);
+    TAIL.initializeDefault(numProcesses);
+}
+
+template<class T>
+void SegmentedCASQueue<T>::enqueue(int x, int process) {
+    Index tail;
+    while (true) {
+        tail = TAIL.LL();
+        NBasketCAS* basket = segments.basket(tail, process, BasketSegments<NBasketCAS>::ENQUEUER);
+        if (basket != nullptr && basket->put(x, process) == OK) {
+            TAIL.IC(tail, process);
+            segments.release(process, BasketSegments<NBasketCAS>::ENQUEUER);
+            return;
+        }
+        TAIL.IC(tail, process);
+    }
+}
+
+template<class T>
+int SegmentedCASQueue<T>::dequeue(int process) {
+    Index head = HEAD.LL();
+    Index tail = TAIL.LL();
+    int x;
+    while (true) {
+        if (head < tail) {
+            NBasketCAS* basket = segments.basket(head, process, BasketSegments<NBasketCAS>::DEQUEUER);
+            x = basket == nullptr ? BASKET_CLOSED : basket->take(process);
+            if (x != BASKET_CLOSED) {
+                segments.release(process, BasketSegments<NBasketCAS>::DEQUEUER);
+                return x;
+            }
+            HEAD.IC(head, process);
+            segments.reclaim(head + 1);
+        }
+        auto hhead = HEAD.LL();
+        auto ttail = TAIL.LL();
+        if (hhead == head && ttail == tail) {
+            segments.release(process, BasketSegments<NBasketCAS>::DEQUEUER);
+            return EMPTY;
+        }
+        head = hhead;
+        tail = ttail;
+    }
+}
+
+// Unbounded version of FAIQueue, with LLICCAS64 (see BasketSegments).
+template<class T>
+class SegmentedFAIQueue {
+private:
+    using Index = decltype(std::declval<T&>().LL());
+
+    int k;
+    int numProcesses;
+    BasketSegments<KBasketFAI> segments;
+    T HEAD;
+    T TAIL;
+public:
+    SegmentedFAIQueue(int k, int numProcesses);
+    void enqueue(int x, int process);
+    int dequeue(int process);
+    void enqueue_bulk(std::span<const int> xs, int process);
+    int dequeue_bulk(std::span<int> xs, int max, int process);
+};
+
+template<class T>
+SegmentedFAIQueue<T>::SegmentedFAIQueue(int k, int numProcesses) : k(k), numProcesses(numProcesses),
+                                                                   segments(k, numProcesses) {
+    HEAD.initializeDefault(numProcesses);
+    TAIL.initializeDefault(numProcesses);
+}
+
+template<class T>
+void SegmentedFAIQueue<T>::enqueue(int x, int process) {
+    Index tail;
+    while (true) {
+        tail = TAIL.LL();
+        KBasketFAI* basket = segments.basket(tail, process, BasketSegments<KBasketFAI>::ENQUEUER);
+        if (basket != nullptr && basket->put(x) == OK) {
+            TAIL.IC(tail, process);
+            segments.release(process, BasketSegments<KBasketFAI>::ENQUEUER);
+            return;
+        }
+        TAIL.IC(tail, process);
+    }
+}
+
+template<class T>
+int SegmentedFAIQueue<T>::dequeue(int process) {
+    Index head = HEAD.LL();
+    Index tail = TAIL.LL();
+    int x;
+    while (true) {
+        if (head < tail) {
+            KBasketFAI* basket = segments.basket(head, process, BasketSegments<KBasketFAI>::DEQUEUER);
+            x = basket == nullptr ? BASKET_CLOSED : basket->take();
+            if (x != BASKET_CLOSED) {
+                segments.release(process, BasketSegments<KBasketFAI>::DEQUEUER);
+                return x;
+            }
+            HEAD.IC(head, process);
+            segments.reclaim(head + 1);
+        }
+        auto hhead = HEAD.LL();
+        auto ttail = TAIL.LL();
+        if (hhead == head && ttail == tail) {
+            segments.release(process, BasketSegments<KBasketFAI>::DEQUEUER);
+            return EMPTY;
+        }
+        head = hhead;
+        tail = ttail;
+    }
+}
+
+template<class T>
+void SegmentedFAIQueue<T>::enqueue_bulk(std::span<const int> xs, int process) {
+    Index tail;
+    while (!xs.empty()) {
+        tail = TAIL.LL();
+        KBasketFAI* basket = segments.basket(tail, process, BasketSegments<KBasketFAI>::ENQUEUER);
+        if (basket != nullptr) {
+            xs = xs.subspan(basket->put_bulk(xs));
+        }
+        TAIL.IC(tail, process);
+    }
+    segments.release(process, BasketSegments<KBasketFAI>::ENQUEUER);
+}
+
+template<class T>
+int SegmentedFAIQueue<T>::dequeue_bulk(std::span<int> xs, int max, int process) {
+    xs = xs.first(std::min((int) xs.size(), max));
+    int taken = 0;
+    Index head = HEAD.LL();
+    Index tail = TAIL.LL();
+    while (taken < (int) xs.size()) {
+        if (head < tail) {
+            KBasketFAI* basket = segments.basket(head, process, BasketSegments<KBasketFAI>::DEQUEUER);
+            int n = basket == nullptr ? BASKET_CLOSED : basket->take_bulk(xs.subspan(taken));
+            if (n != BASKET_CLOSED) {
+                taken += n;
+                continue;
+            }
+            HEAD.IC(head, process);
+            segments.reclaim(head + 1);
+        }
+        auto hhead = HEAD.LL();
+        auto ttail = TAIL.LL();
+        if (hhead == head && ttail == tail) {
+            break;
+        }
+        head = hhead;
+        tail = ttail;
+    }
+    segments.release(process, BasketSegments<KBasketFAI>::DEQUEUER);
+    return taken;
+}
+
+// Bounded version of FAIQueue over a ring of capacity baskets. Index
+// i is served by basket i % capacity during lap i / capacity, and
+// every word of a basket carries the lap it belongs to:
+//
+// - PUTS and TAKES are (lap << 32 | counter).
+// - Each item is (lap << 32 | value).
+//
+// HEAD and TAIL must be 64-bit LL/IC objects (LLICCAS64), so the
+// indices never wrap. The lap stored in the words keeps its low 32
+// bits and is compared by the sign of the difference, which is
+// correct while the laps in use are less than 2^31 apart.
+//
+// A take replaces the item with (lap + 1, BOTTOM), so a late putter
+// of the old lap fails its CAS. TAKES is claimed by CAS, so exactly k
+// takers touch the basket by lap, and the last of them to finish
+// (DONE) reopens the basket for the next lap. enqueue returns FULL
+// instead of writing past the ring when TAIL is capacity baskets
+// ahead of HEAD, or when the basket at TAIL is still being drained
+// from the previous lap. All memory is allocated by the constructor.
+template<class T>
+class CircularFAIQueue {
+private:
+    static_assert(sizeof(decltype(std::declval<T&>().LL())) == sizeof(uint64_t),
+                  "CircularFAIQueue necesita un objeto LL/IC de 64 bits");
+
+    enum RING_PUT {PUT_OK, PUT_SKIP, PUT_WAIT};
+
+    struct alignas(64) Basket {
+        std::atomic<uint64_t> PUTS{0};
+        alignas(64) std::atomic<uint64_t> TAKES{0};
+        std::atomic<int> DONE{0};
+    };
+
+    int capacity;
+    int k;
+    int numProcesses;
+    Basket *A;
+    std::atomic<uint64_t> *items;
+    T HEAD;
+    T TAIL;
+
+    static uint64_t pack(uint32_t lap, int value) {
+        return ((uint64_t) lap << 32) | (uint32_t) value;
+    }
+
+    static uint32_t lapOf(uint64_t word) {
+        return word >> 32;
+    }
+
+    static int valueOf(uint64_t word) {
+        return (int) (uint32_t) word;
+    }
+
+    // Sign of lapOf(word) - lap, wrap-safe
+    static int compareLap(uint64_t word, uint32_t lap) {
+        int32_t diff = (int32_t) (lapOf(word) - lap);
+        return diff < 0 ? -1 : diff > 0;
+    }
+
+    RING_PUT put(uint64_t index, int x);
+    int take(uint64_t index);
+public:
+    CircularFAIQueue(int capacity, int k, int numProcesses);
+    STATE_PUT enqueue(int x, int process);
+    int dequeue(int process);
+    ~CircularFAIQueue();
+};
+
+template<class T>
+CircularFAIQueue<T>::CircularFAIQueue(int capacity, int k, int numProcesses) : capacity(capacity), k(k),
+                                                                              numProcesses(numProcesses) {
+    A = new Basket[capacity];
+    items = new std::atomic<uint64_t>[(std::size_t) capacity * k];
+    for (std::size_t i = 0; i < (std::size_t) capacity * k; i++) {
+        items[i].store(pack(0, BOTTOM), std::memory_order_relaxed);
+    }
+    HEAD.initializeDefault(numProcesses);
+    TAIL.initializeDefault(numProcesses);
+}
+
+template<class T>
+typename CircularFAIQueue<T>::RING_PUT CircularFAIQueue<T>::put(uint64_t index, int x) {
+    Basket& basket = A[index % capacity];
+    uint32_t lap = index / capacity;
+    uint64_t puts;
+    while (true) {
+        puts = basket.PUTS.load();
+        if (compareLap(puts, lap) < 0) {
+            return PUT_WAIT;
+        } else if (compareLap(puts, lap) > 0 || valueOf(puts) >= k) {
+            return PUT_SKIP;
+        }
+        puts = basket.PUTS.fetch_add(1);
+        if (lapOf(puts) != lap || valueOf(puts) >= k) {
+            return PUT_SKIP;
+        }
+        uint64_t bottom = pack(lap, BOTTOM);
+        std::size_t slot = (std::size_t) (index % capacity) * k + valueOf(puts);
+        if (items[slot].compare_exchange_strong(bottom, pack(lap, x))) {
+            return PUT_OK;
+        }
+    }
+}
+
+template<class T>
+int CircularFAIQueue<T>::take(uint64_t index) {
+    Basket& basket = A[index % capacity];
+    uint32_t lap = index / capacity;
+    uint64_t takes;
+    while (true) {
+        takes = basket.TAKES.load();
+        if (lapOf(takes) != lap || valueOf(takes) >= k) {
+            return BASKET_CLOSED;
+        }
+        if (!basket.TAKES.compare_exchange_weak(takes, takes + 1)) {
+            continue;
+        }
+        std::size_t slot = (std::size_t) (index % capacity) * k + valueOf(takes);
+        uint64_t item = items[slot].exchange(pack(lap + 1, BOTTOM));
+        if (basket.DONE.fetch_add(1) == k - 1) { // Reopen for the next lap
+            basket.DONE.store(0);
+            basket.TAKES.store(pack(lap + 1, 0));
+            basket.PUTS.store(pack(lap + 1, 0));
+        }
+        if (valueOf(item) != BOTTOM) return valueOf(item);
+    }
+}
+
+template<class T>
+STATE_PUT CircularFAIQueue<T>::enqueue(int x, int process) {
+    uint64_t tail;
+    while (true) {
+        tail = TAIL.LL();
+        if (tail - HEAD.LL() >= (uint64_t) capacity) {
+            return FULL;
+        }
+        RING_PUT state = put(tail, x);
+        if (state == PUT_WAIT) {
+            return FULL;
+        }
+        TAIL.IC(tail, process);
+        if (state == PUT_OK) {
+            return OK;
+        }
+    }
+}
+
+template<class T>
+int CircularFAIQueue<T>::dequeue(int process) {
+    uint64_t head = HEAD.LL();
+    uint64_t tail = TAIL.LL();
+    int x;
+    while (true) {
+        if (head < tail) {
+            x = take(head);
+            if (x != BASKET_CLOSED) {
+                return x;
+            }
+            HEAD.IC(head, process);
+        }
+        auto hhead = HEAD.LL();
+        auto ttail = TAIL.LL();
+        if (hhead == head && ttail == tail) {
+            return EMPTY;
+        }
+        head = hhead;
+        tail = ttail;
+    }
+}
+
+template<class T>
+CircularFAIQueue<T>::~CircularFAIQueue() {
+    delete[] A;
+    delete[] items;
+}
+
+// Monolithic version of FAIQueue<LLICCAS>, the best combination in
+// analysis/data (LL/IC CAS + basket FAI). Instead of composing two
+// LLICCAS objects with an array of KBasketFAI (each one with its own
+// heap array of items), the counters and the baskets are laid out
+// together:
+//
+// - HEAD and TAIL live in their own cache line each, so enqueuers
+//   and dequeuers do not invalidate each other's counter.
+// - Each basket starts at a cache line boundary and stores its PUTS,
+//   TAKES and STATE words followed by its items, so PUTS and the
+//   first 13 items share the same line. An enqueue with k <= 13
+//   touches only the TAIL line and one basket line.
+//
+// The LL/IC and put/take operations are inlined in enqueue/dequeue.
+class FusedFAIQueue {
+private:
+    static const int CACHE_LINE = 64;
+    static const int LINE_INTS = CACHE_LINE / sizeof(std::atomic<int>);
+    static const int PUTS_OFFSET = 0;
+    static const int TAKES_OFFSET = 1;
+    static const int STATE_OFFSET = 2;
+    static const int ITEMS_OFFSET = 3;
+
+    int capacity;
+    int k;
+    int numProcesses;
+    int stride; // Words by basket, multiple of a cache line
+    std::atomic<int> *A;
+    alignas(CACHE_LINE) std::atomic<int> HEAD{0};
+    alignas(CACHE_LINE) std::atomic<int> TAIL{0};
+    alignas(CACHE_LINE) char pad[CACHE_LINE];
+
+    std::atomic<int>* basket(int index);
+    STATE_PUT put(std::atomic<int>* basket, int x);
+    int take(std::atomic<int>* basket);
+public:
+    FusedFAIQueue(int capacity, int k, int numProcesses);
+    void enqueue(int x, int process);
+    int dequeue(int process);
+    ~FusedFAIQueue();
+};
 #endif
@@ -2,6 +2,7 @@
 #define KBASKET_HPP
 #include <unordered_set>
 #include <atomic>
+#include <span>
 #include "utils.hpp" // Se declaran los estados para el basket y para put
 
 class KBasketFAI
@@ -22,6 +23,9 @@ public:
 
     STATE_PUT put(int x);
     int take();
+    // Bulk versions, they reserve the slots with a single fetch&add
+    int put_bulk(std::span<const int> xs);
+    int take_bulk(std::span<int> xs);
 };
 
 class NBasketCAS
@@ -1,6 +1,7 @@
 #ifndef LLIC_HPP
 #define LLIC_HPP
 #include <atomic>
+#include <cstdint>
 #include <stdalign.h>
 
 // https://en.cppreference.com/w/cpp/language/object#Alignment
@@ -234,6 +235,21 @@ public:
     void initializeDefault(int n);
 };
 
+// LLICCAS with 64-bit values, for the queues whose indices must not
+// wrap (CircularFAIQueue derives the lap of a basket from them).
+class LLICCAS64
+{
+private:
+    std::atomic<uint64_t> R{0};
+
+public:
+    LLICCAS64();
+    uint64_t LL();
+    void IC(uint64_t expected);
+    void IC(uint64_t expected, int process);
+    void initializeDefault(int n);
+};
+
 class LLICCAST
 {
 private:
@@ -12,3 +12,107 @@
 // - SQRT
 // - Fetch&Inc
 // - Grouped 16 bytes
+
+#include <new>
+#include "include/basket_queue.hpp"
+
+//////////////////////////////////////////////
+// Monolithic LLIC CAS + Basket FAI queue   //
+//////////////////////////////////////////////
+
+FusedFAIQueue::FusedFAIQueue(int capacity, int k, int numProcesses) : capacity(capacity), k(k),
+                                                                      numProcesses(numProcesses) {
+    UNUSED(this->numProcesses);
+    stride = ((ITEMS_OFFSET + k + LINE_INTS - 1) / LINE_INTS) * LINE_INTS;
+    std::size_t words = (std::size_t) capacity * stride;
+    A = static_cast<std::atomic<int>*>(::operator new[](words * sizeof(std::atomic<int>),
+                                                        std::align_val_t(CACHE_LINE)));
+    for (std::size_t i = 0; i < words; i++) {
+        new (&A[i]) std::atomic<int>(BOTTOM);
+    }
+    for (int i = 0; i < capacity; i++) {
+        A[(std::size_t) i * stride + PUTS_OFFSET].store(0, std::memory_order_relaxed);
+        A[(std::size_t) i * stride + TAKES_OFFSET].store(0, std::memory_order_relaxed);
+        A[(std::size_t) i * stride + STATE_OFFSET].store(OPEN, std::memory_order_relaxed);
+    }
+}
+
+FusedFAIQueue::~FusedFAIQueue() {
+    ::operator delete[](A, std::align_val_t(CACHE_LINE));
+}
+
+inline std::atomic<int>* FusedFAIQueue::basket(int index) {
+    return &A[(std::size_t) index * stride];
+}
+
+inline STATE_PUT FusedFAIQueue::put(std::atomic<int>* basket, int x) {
+    int puts;
+    while (true) {
+        puts = basket[PUTS_OFFSET].load();
+        if (basket[STATE_OFFSET].load() == CLOSED || puts >= k) {
+            return FULL;
+        }
+        puts = basket[PUTS_OFFSET].fetch_add(1);
+        if (puts >= k) {
+            return FULL;
+        } else if (basket[ITEMS_OFFSET + puts].exchange(x) == BOTTOM) {
+            return OK;
+        }
+    }
+}
+
+inline int FusedFAIQueue::take(std::atomic<int>* basket) {
+    int takes;
+    while (true) {
+        takes = basket[TAKES_OFFSET].load();
+        if (basket[STATE_OFFSET].load() == CLOSED || takes >= k) {
+            return BASKET_CLOSED;
+        }
+        takes = basket[TAKES_OFFSET].fetch_add(1);
+        if (takes >= k) {
+            basket[STATE_OFFSET].store(CLOSED);
+            return BASKET_CLOSED;
+        }
+        int x = basket[ITEMS_OFFSET + takes].exchange(TOP);
+        if (x != BOTTOM) return x;
+    }
+}
+
+void FusedFAIQueue::enqueue(int x, int process) {
+    UNUSED(process);
+    int tail;
+    while (true) {
+        tail = TAIL.load();
+        STATE_PUT state = put(basket(tail), x);
+        if (TAIL.load() == tail) { // IC
+            TAIL.compare_exchange_strong(tail, tail + 1);
+        }
+        if (state == OK) return;
+    }
+}
+
+int FusedFAIQueue::dequeue(int process) {
+    UNUSED(process);
+    int head = HEAD.load();
+    int tail = TAIL.load();
+    int x;
+    while (true) {
+        if (head < tail) {
+            x = take(basket(head));
+            if (x != BASKET_CLOSED) {
+                return x;
+            }
+            int expected = head;
+            if (HEAD.load() == expected) { // IC
+                HEAD.compare_exchange_strong(expected, expected + 1);
+            }
+        }
+        int hhead = HEAD.load();
+        int ttail = TAIL.load();
+        if (hhead == head && ttail == tail) {
+            return EMPTY;
+        }
+        head = hhead;
+        tail = ttail;
+    }
+}
@@ -76,6 +76,59 @@ int KBasketFAI::take()
     }
 }
 
+// Puts the longest prefix of xs that fits in the basket, reserving
+// its slots with one fetch&add. Returns the number of items stored,
+// 0 if the basket is full. Items keep their order: once a slot is
+// lost to a taker, the rest of xs is left for the next basket.
+int KBasketFAI::put_bulk(std::span<const int> xs)
+{
+    int puts;
+    while(true) {
+        puts = PUTS.load();
+        if (STATE.load() == CLOSED || puts >= size_k) {
+            return 0;
+        }
+        int m = std::min((int) xs.size(), size_k - puts);
+        puts = PUTS.fetch_add(m);
+        if (puts >= size_k) {
+            return 0;
+        }
+        int end = std::min(puts + m, size_k);
+        int stored = 0;
+        for (int i = puts; i < end; i++) {
+            if (A[i].exchange(xs[stored]) != BOTTOM) break;
+            stored++;
+        }
+        if (stored > 0) return stored;
+    }
+}
+
+// Takes up to xs.size() items, reserving the slots with one
+// fetch&add. Returns the number of items taken or BASKET_CLOSED.
+int KBasketFAI::take_bulk(std::span<int> xs)
+{
+    int takes;
+    while (true) {
+        takes = TAKES.load();
+        if (STATE.load() == CLOSED or takes >= size_k) {
+            return BASKET_CLOSED;
+        }
+        int m = std::min((int) xs.size(), size_k - takes);
+        takes = TAKES.fetch_add(m);
+        if (takes >= size_k) {
+            STATE.store(CLOSED, std::memory_order_seq_cst);
+            return BASKET_CLOSED;
+        }
+        int end = std::min(takes + m, size_k);
+        int taken = 0;
+        for (int i = takes; i < end; i++) {
+            int x = A[i].exchange(TOP);
+            if (x != BOTTOM) xs[taken++] = x;
+        }
+        if (taken > 0) return taken;
+    }
+}
+
 NBasketCAS::NBasketCAS() {}
 
 NBasketCAS::NBasketCAS(int n) : size_n(n)
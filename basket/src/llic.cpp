@@ -31,6 +31,26 @@ void LLICCAS::IC(int expected, int process) {
 
 void LLICCAS::initializeDefault(int n) {}
 
+LLICCAS64::LLICCAS64() {}
+
+uint64_t LLICCAS64::LL()
+{
+    return R.load();
+}
+
+void LLICCAS64::IC(uint64_t expected)
+{
+    if (R.load() == expected) {
+        R.compare_exchange_strong(expected, expected + 1);
+    }
+}
+
+void LLICCAS64::IC(uint64_t expected, int) {
+    this->IC(expected);
+}
+
+void LLICCAS64::initializeDefault(int) {}
+
 /////////////////////
 // 64 bits version //
 /////////////////////
@@ -12,4 +12,5 @@ int main() {
     // queue_time_experiments(10);
     // exp_llic::experiments();
     exp_queue::experiments();
+    // exp_queue::experiments_fused();
 }
@@ -0,0 +1,132 @@
+#ifndef _Backoff_HPP_
+#define _Backoff_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+
+// Contention management policies for the retry loops of the queues.
+// A loop calls its Backoff object after each failed attempt (a CAS
+// that lost, a ticket that could not be used), so the threads stop
+// hammering the same cache line. The object is kept per thread
+// (static thread_local) between operations and reset() is called
+// after a success, so the adaptive policies carry what they learned
+// from one operation to the next.
+
+// - NoBackoff: retries immediately (the original behaviour).
+// - PauseBackoff: one pause instruction per failure.
+// - ExponentialBackoff<MIN, MAX>: MIN pauses, doubled on each
+//   failure up to MAX.
+// - RandomBackoff<MIN, MAX>: as the exponential one, but waits a
+//   random number of pauses below the limit, so the threads that
+//   failed together do not retry together.
+// - ProportionalBackoff<STEP, MAX>: waits STEP pauses per failure
+//   observed recently. reset() halves the count instead of clearing
+//   it, so the wait follows the contention of the last operations.
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+struct NoBackoff {
+    static std::string name() {
+        return "NONE";
+    }
+
+    void operator()() {}
+
+    void reset() {}
+};
+
+struct PauseBackoff {
+    static std::string name() {
+        return "PAUSE";
+    }
+
+    void operator()() {
+        cpu_relax();
+    }
+
+    void reset() {}
+};
+
+template<int MIN = 4, int MAX = 1024>
+class ExponentialBackoff {
+private:
+    int limit{MIN};
+public:
+    static std::string name() {
+        return "EXP" + std::to_string(MAX);
+    }
+
+    void operator()() {
+        for (int i = 0; i < limit; i++) cpu_relax();
+        limit = std::min(2 * limit, MAX);
+    }
+
+    void reset() {
+        limit = MIN;
+    }
+};
+
+template<int MIN = 4, int MAX = 1024>
+class RandomBackoff {
+private:
+    int limit{MIN};
+
+    // xorshift, one state per thread
+    static uint64_t next() {
+        static thread_local uint64_t seed = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return seed;
+    }
+
+public:
+    static std::string name() {
+        return "RAND" + std::to_string(MAX);
+    }
+
+    void operator()() {
+        int spins = next() % limit;
+        for (int i = 0; i < spins; i++) cpu_relax();
+        limit = std::min(2 * limit, MAX);
+    }
+
+    void reset() {
+        limit = MIN;
+    }
+};
+
+template<int STEP = 16, int MAX = 1024>
+class ProportionalBackoff {
+private:
+    int failures{0};
+public:
+    static std::string name() {
+        return "PROP" + std::to_string(STEP);
+    }
+
+    void operator()() {
+        failures++;
+        int spins = std::min(failures * STEP, MAX);
+        for (int i = 0; i < spins; i++) cpu_relax();
+    }
+
+    void reset() {
+        failures /= 2;
+    }
+};
+
+#endif
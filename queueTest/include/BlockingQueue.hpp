@@ -0,0 +1,110 @@
+#ifndef _BLOCKING_QUEUE_HPP_
+#define _BLOCKING_QUEUE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "Backoff.hpp"
+#include "ThreadHandle.hpp"
+
+namespace blocking_queue {
+
+    static constexpr int SPIN_TRIES = 128;
+
+    // Wrapper that adds a blocking dequeue to any queue of the
+    // battery. dequeue_wait first spins on the wrapped queue and then
+    // parks the thread on a futex over epoch.
+
+    // The consumer announces itself in waiters before its last check
+    // of the queue, and the producer reads waiters after its enqueue,
+    // so one of them sees the other (both operations are seq_cst and
+    // the wrapped enqueues publish the item with a seq_cst
+    // RMW). Producers only bump the epoch and call FUTEX_WAKE when
+    // there are sleepers; otherwise an enqueue pays one extra load.
+    template<typename T, typename Queue>
+    class BlockingQueue : public ThreadRegistration<BlockingQueue<T, Queue>> {
+    private:
+        Queue queue;
+        alignas(64) std::atomic<uint32_t> epoch{0};
+        alignas(64) std::atomic<int> waiters{0};
+        alignas(64) char pad[64];
+
+        static long futex(std::atomic<uint32_t>* addr, int op, uint32_t val, const struct timespec* timeout) {
+            return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), op, val, timeout, nullptr, 0);
+        }
+
+        void wake() {
+            epoch.fetch_add(1);
+            futex(&epoch, FUTEX_WAKE_PRIVATE, 1, nullptr);
+        }
+
+    public:
+        BlockingQueue(std::size_t max_threads = 64) : queue{max_threads} {}
+
+        static std::string name() {
+            return "BLOCKING";
+        }
+
+        // Called by a thread that will not use the queue anymore
+        void release(std::size_t thread_id) {
+            if constexpr (requires { queue.release(thread_id); }) {
+                queue.release(thread_id);
+            }
+        }
+
+        using ThreadRegistration<BlockingQueue>::enqueue;
+        using ThreadRegistration<BlockingQueue>::dequeue;
+        using ThreadRegistration<BlockingQueue>::approx_size;
+
+        void enqueue(T* item, std::size_t thread_id) {
+            queue.enqueue(item, thread_id);
+            if (waiters.load() != 0) wake();
+        }
+
+        T* dequeue(std::size_t thread_id) {
+            return queue.dequeue(thread_id);
+        }
+
+        std::size_t approx_size(std::size_t thread_id) {
+            return queue.approx_size(thread_id);
+        }
+
+        // Returns nullptr only when the queue stays empty for timeout
+        template<typename Rep, typename Period>
+        T* dequeue_wait(std::size_t thread_id, std::chrono::duration<Rep, Period> timeout) {
+            T* item;
+            for (int i = 0; i < SPIN_TRIES; i++) {
+                if ((item = queue.dequeue(thread_id)) != nullptr) return item;
+                cpu_relax();
+            }
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (true) {
+                uint32_t e = epoch.load();
+                waiters.fetch_add(1);
+                if ((item = queue.dequeue(thread_id)) != nullptr) {
+                    waiters.fetch_sub(1);
+                    return item;
+                }
+                auto remaining = deadline - std::chrono::steady_clock::now();
+                if (remaining <= std::chrono::nanoseconds::zero()) {
+                    waiters.fetch_sub(1);
+                    return nullptr;
+                }
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+                struct timespec ts{ns / 1'000'000'000, ns % 1'000'000'000};
+                futex(&epoch, FUTEX_WAIT_PRIVATE, e, &ts);
+                waiters.fetch_sub(1);
+                if ((item = queue.dequeue(thread_id)) != nullptr) return item;
+            }
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef _Cells_HPP_
+#define _Cells_HPP_
+
+#include <cstdint>
+#include <limits>
+
+
+// Encodings of the values stored in the cells of the array based
+// queues (FAAArrayQueue, the baskets of llic_queue). A cell policy
+// gives the type of the values and the reserved values that the
+// queues use as sentinels:
+
+// - value_type: what enqueue receives and dequeue returns. The cells
+//   are std::atomic<value_type>.
+// - null(): returned by dequeue when the queue is empty. It can not
+//   be enqueued.
+// - marker(i), 0 <= i < MARKERS: reserved values for the states of a
+//   cell (taken, bottom, closed...). They can not be enqueued.
+
+// PointerCell stores T* (the default of every queue). CompactCell
+// stores 32-bit values directly (message ids, indices of an arena),
+// so a cache line holds twice the cells and dequeue returns the value
+// without a pointer indirection. The top MARKERS + 1 values of
+// uint32_t are reserved.
+
+template<typename T>
+struct PointerCell {
+    using value_type = T*;
+    static constexpr int MARKERS = 4;
+
+    static constexpr value_type null() {
+        return nullptr;
+    }
+
+    static value_type marker(int i) {
+        return reinterpret_cast<T*>(std::numeric_limits<uintptr_t>::max() - i);
+    }
+
+    static bool valid(value_type val) {
+        return val != nullptr && reinterpret_cast<uintptr_t>(val) < std::numeric_limits<uintptr_t>::max() - MARKERS;
+    }
+};
+
+struct CompactCell {
+    using value_type = uint32_t;
+    static constexpr int MARKERS = 4;
+
+    static constexpr value_type null() {
+        return std::numeric_limits<uint32_t>::max();
+    }
+
+    static constexpr value_type marker(int i) {
+        return std::numeric_limits<uint32_t>::max() - 1 - i;
+    }
+
+    static constexpr bool valid(value_type val) {
+        return val < std::numeric_limits<uint32_t>::max() - MARKERS;
+    }
+};
+
+#endif
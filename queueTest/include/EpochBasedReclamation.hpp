@@ -0,0 +1,145 @@
+#ifndef _Epoch_Based_Reclamation_HPP_
+#define _Epoch_Based_Reclamation_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ThreadRegistry.hpp"
+#include "Intrusive.hpp"
+
+
+// Epoch based reclamation with the same interface as
+// MemoryManagementPool, so the queues can use either of them.
+
+// - The first protect (or protectPointer) of an operation enters a
+//   critical section announcing the global epoch. The next ones only
+//   load the pointer, without the store and re-read of the hazard
+//   pointers.
+// - clear(thread_id) leaves the critical section. clearOne does
+//   nothing.
+// - retire(ptr, thread_id) tags the object with the global epoch. An
+//   object retired in epoch e is deleted when the global epoch
+//   reaches e + 2, that is, when every thread that could see it has
+//   left its critical section.
+
+// A thread that stalls inside a critical section blocks all the
+// reclamation (unlike hazard pointers, that only keep K objects).
+
+// The state of each thread is a row of a ThreadRegistry, so the
+// epoch only waits for the threads registered now.
+
+template <typename T>
+class EpochBasedReclamation {
+private:
+    static const int THREADS_MAX = 64;
+
+    // Announced epoch << 1 | 1 while the thread is in a critical
+    // section, 0 otherwise.
+    struct alignas(128) ThreadState {
+        std::atomic<uint64_t> announce{0};
+        std::vector<std::pair<T*, uint64_t>> retired;
+    };
+
+    alignas(128) std::atomic<uint64_t> globalEpoch{2};
+    ThreadRegistry<ThreadState> states;
+
+    const int max_Threads;
+    const std::size_t threshold;
+
+    void enter(const int thread_id) {
+        std::atomic<uint64_t>& announce = states.get(thread_id).announce;
+        if (announce.load(std::memory_order_relaxed) != 0) return;
+        uint64_t epoch = globalEpoch.load();
+        while (true) {
+            announce.store((epoch << 1) | 1);
+            uint64_t curr = globalEpoch.load();
+            if (curr == epoch) return;
+            epoch = curr;
+        }
+    }
+
+    void tryAdvance() {
+        uint64_t epoch = globalEpoch.load();
+        bool behind = false;
+        states.forEachLive([&behind, epoch](ThreadState& state) {
+            uint64_t announce = state.announce.load();
+            if (announce != 0 && (announce >> 1) != epoch) behind = true;
+        });
+        if (!behind) globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+    }
+
+public:
+    EpochBasedReclamation(int max_HP = 0, int max_threads = THREADS_MAX) :
+        max_Threads(max_threads), threshold(2 * max_threads) {
+        (void) max_HP;
+    }
+
+    ~EpochBasedReclamation() {
+        states.forEach([](ThreadState& state) {
+            for (auto& entry : state.retired) {
+                dispose_object(entry.first);
+            }
+        });
+    }
+
+    static std::string name() {
+        return "EBR";
+    }
+
+    template<typename... Args>
+    T* allocate(const int thread_id, Args&&... args) {
+        (void) thread_id;
+        return new T(std::forward<Args>(args)...);
+    }
+
+    void clear(const int thread_id) {
+        states.get(thread_id).announce.store(0, std::memory_order_release);
+    }
+
+    void clearOne(int hp_idx, const int thread_id) {
+        (void) hp_idx;
+        (void) thread_id;
+    }
+
+    // The thread leaves, the epoch stops waiting for it. Its retired
+    // objects stay in the row until the id is used again or the pool
+    // is destroyed.
+    void release(const int thread_id) {
+        clear(thread_id);
+        states.release(thread_id);
+    }
+
+    T* protect(int hp_idx, const std::atomic<T*>& atom, const int thread_id) {
+        (void) hp_idx;
+        enter(thread_id);
+        return atom.load();
+    }
+
+    T* protectPointer(int hp_idx, T* pointer, const int thread_id) {
+        (void) hp_idx;
+        enter(thread_id);
+        return pointer;
+    }
+
+    bool retire(T* ptr, const int thread_id) {
+        std::vector<std::pair<T*, uint64_t>>& retired = states.get(thread_id).retired;
+        retired.emplace_back(ptr, globalEpoch.load());
+        if (retired.size() < threshold) return false;
+        tryAdvance();
+        uint64_t epoch = globalEpoch.load();
+        std::size_t kept = 0;
+        for (auto& entry : retired) {
+            if (entry.second + 2 <= epoch) {
+                dispose_object(entry.first);
+            } else {
+                retired[kept++] = entry;
+            }
+        }
+        retired.resize(kept);
+        return true;
+    }
+};
+
+#endif
@@ -16,13 +16,21 @@
 #include <vector>
 #include <fstream>
 #include <exception>
+#include <algorithm>
+#include <mutex>
 #include "nlohmann/json.hpp"
 #include "include/FAAArrayQueue.hpp"
 #include "include/MichaelScottQueue.hpp"
 #include "include/LCRQ.hpp"
+#include "include/LPRQ.hpp"
 #include "include/YMCQueue.hpp"
 #include "include/SBQQueue.hpp"
 #include "include/LLICQueue.hpp"
+#include "include/BlockingQueue.hpp"
+#include "include/SPSCQueue.hpp"
+#include "include/EpochBasedReclamation.hpp"
+#include "include/HazardErasPool.hpp"
+#include "include/Backoff.hpp"
 #include "include/utils.hpp"
 
 using json = nlohmann::json;
@@ -238,6 +246,271 @@ namespace experiments {
     };
 
 
+    struct WakeupMessage {
+        std::chrono::steady_clock::time_point sent;
+        bool stop = false;
+    };
+
+    // Idle CPU vs wakeup latency. A producer sends messages spaced by
+    // gap to consumers that wait for them spinning on dequeue
+    // (blocking = false) or parked in dequeue_wait. It reports the
+    // latency between the enqueue and the dequeue of each message and
+    // the fraction of the wall time that consumers spent on the CPU.
+    template<typename Queue>
+    json wakeup_latency_test(int consumers, int messages, std::chrono::microseconds gap, bool blocking) {
+        Queue queue{(std::size_t) consumers + 1};
+        std::vector<WakeupMessage> msgs(messages + consumers);
+        std::vector<long> latencies;
+        std::mutex latenciesMutex;
+        std::atomic<long> cpuTime{0};
+        std::vector<std::thread> threads;
+        std::function<void(int)> func = [&] (const int thread_id) {
+            std::vector<long> local;
+            while (true) {
+                WakeupMessage* msg = blocking ? queue.dequeue_wait(thread_id, 100ms) : queue.dequeue(thread_id);
+                if (msg == nullptr) continue;
+                if (msg->stop) break;
+                auto now = std::chrono::steady_clock::now();
+                local.push_back(std::chrono::duration<long, std::nano>(now - msg->sent).count());
+            }
+            struct timespec cpu;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+            cpuTime += cpu.tv_sec * 1'000'000'000l + cpu.tv_nsec;
+            std::lock_guard<std::mutex> lock(latenciesMutex);
+            latencies.insert(latencies.end(), local.begin(), local.end());
+        };
+        auto t_start = std::chrono::steady_clock::now();
+        for (int i = 0; i < consumers; i++) {
+            threads.push_back(std::thread(func, i));
+        }
+        for (int i = 0; i < messages; i++) {
+            std::this_thread::sleep_for(gap);
+            msgs[i].sent = std::chrono::steady_clock::now();
+            queue.enqueue(&msgs[i], consumers);
+        }
+        for (int i = messages; i < messages + consumers; i++) {
+            msgs[i].stop = true;
+            queue.enqueue(&msgs[i], consumers);
+        }
+        for (std::thread &th: threads) {
+            if (th.joinable()) {
+                th.join();
+            }
+        }
+        auto t_end = std::chrono::steady_clock::now();
+        long wall = std::chrono::duration<long, std::nano>(t_end - t_start).count();
+
+        std::sort(latencies.begin(), latencies.end());
+        long sum = 0;
+        for (long l : latencies) sum += l;
+        json result;
+        result["mean_latency_ns"] = latencies.empty() ? 0 : sum / (long) latencies.size();
+        result["p99_latency_ns"] = latencies.empty() ? 0 : latencies[latencies.size() * 99 / 100];
+        result["consumer_cpu_ratio"] = (double) cpuTime.load() / ((double) wall * consumers);
+        return result;
+    };
+
+    // Empty polling. One producer enqueues items while pollers call
+    // dequeue in a loop, so the queue is empty almost all the time. It
+    // reports the time of the producer and the fraction of the polls
+    // that found the queue empty. The slowdown against the run
+    // without pollers measures how much the empty dequeues disturb
+    // the producer.
+    template<typename Queue>
+    json empty_polling_test(int pollers, int items) {
+        Queue queue{(std::size_t) pollers + 1};
+        std::vector<std::string> values(items, "item");
+        std::atomic<bool> stop{false};
+        std::atomic<long> polls{0};
+        std::atomic<long> empties{0};
+        std::vector<std::thread> threads;
+        std::function<void(int)> func = [&] (const int thread_id) {
+            long localPolls = 0;
+            long localEmpties = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                localPolls++;
+                if (queue.dequeue(thread_id) == nullptr) localEmpties++;
+            }
+            polls += localPolls;
+            empties += localEmpties;
+        };
+        for (int i = 0; i < pollers; i++) {
+            threads.push_back(std::thread(func, i));
+        }
+        auto t_start = std::chrono::steady_clock::now();
+        for (int i = 0; i < items; i++) {
+            queue.enqueue(&values[i], pollers);
+        }
+        auto t_end = std::chrono::steady_clock::now();
+        stop.store(true);
+        for (std::thread &th: threads) {
+            if (th.joinable()) {
+                th.join();
+            }
+        }
+        while (queue.dequeue(pollers) != nullptr);
+        json result;
+        result["producer_ns"] = std::chrono::duration<long, std::nano>(t_end - t_start).count();
+        result["empty_ratio"] = polls.load() == 0 ? 0.0 : (double) empties.load() / polls.load();
+        return result;
+    };
+
+    template<typename Queue>
+    json experimentEmptyPolling(int pollers, int items) {
+        json exp_json;
+        double base = 0;
+        for (int i = 0; i <= pollers; i = i == 0 ? 1 : i * 2) {
+            std::cout << "Pollers: " << i << "; items: " << items << std::endl;
+            json result = empty_polling_test<Queue>(i, items);
+            long ns = result["producer_ns"];
+            if (i == 0) base = ns;
+            result["slowdown"] = base == 0 ? 0.0 : ns / base;
+            exp_json[std::to_string(i)] = result;
+        }
+        return exp_json;
+    };
+
+    // Producers/consumers split. The producers enqueue items in total,
+    // retrying while a bounded queue is full, and the consumers
+    // dequeue until every item was taken. Thread ids are given to the
+    // producers first. It measures the queues specialized for one
+    // producer or one consumer (see Roles.hpp) against the general
+    // ones with the same threads.
+    template<typename Queue>
+    json split_test(int producers, int consumers, int items) {
+        Queue queue{(std::size_t) (producers + consumers)};
+        std::vector<std::string> values(items, "item");
+        std::atomic<int> consumed{0};
+        std::barrier sync_point(producers + consumers);
+        std::vector<std::thread> threads;
+        std::function<void(int)> produce = [&] (const int thread_id) {
+            sync_point.arrive_and_wait();
+            for (int i = thread_id; i < items; i += producers) {
+                if constexpr (std::is_void_v<decltype(queue.enqueue(&values[i], thread_id))>) {
+                    queue.enqueue(&values[i], thread_id);
+                } else {
+                    // A bounded queue (SegmentRing) stores nothing when
+                    // FULL, the consumers wait for every item
+                    while (queue.enqueue(&values[i], thread_id) == llic_queue::StatePut::FULL) cpu_relax();
+                }
+            }
+        };
+        std::function<void(int)> consume = [&] (const int thread_id) {
+            sync_point.arrive_and_wait();
+            while (consumed.load(std::memory_order_relaxed) < items) {
+                if (queue.dequeue(thread_id) != nullptr) consumed++;
+            }
+        };
+        auto t_start = std::chrono::steady_clock::now();
+        for (int i = 0; i < producers; i++) {
+            threads.push_back(std::thread(produce, i));
+        }
+        for (int i = 0; i < consumers; i++) {
+            threads.push_back(std::thread(consume, producers + i));
+        }
+        for (std::thread &th: threads) {
+            if (th.joinable()) {
+                th.join();
+            }
+        }
+        auto t_end = std::chrono::steady_clock::now();
+        long ns = std::chrono::duration<long, std::nano>(t_end - t_start).count();
+        json result;
+        result["producers"] = producers;
+        result["consumers"] = consumers;
+        result["time_ns"] = ns;
+        result["ops_per_us"] = ns == 0 ? 0.0 : 2000.0 * items / ns;
+        return result;
+    };
+
+    // Sweeps the multiple side (1, 2, 4... up to threads) with one
+    // thread on the other side: many producers and one consumer when
+    // manyProducers, one producer and many consumers otherwise.
+    template<typename Queue>
+    json experimentSplit(int threads, int items, bool manyProducers) {
+        json exp_json;
+        for (int i = 1; i <= threads; i *= 2) {
+            int producers = manyProducers ? i : 1;
+            int consumers = manyProducers ? 1 : i;
+            std::cout << "Producers: " << producers << "; consumers: " << consumers << "; items: " << items << std::endl;
+            exp_json[std::to_string(producers) + ":" + std::to_string(consumers)] =
+                split_test<Queue>(producers, consumers, items);
+        }
+        return exp_json;
+    };
+
+    // Message of the intrusive queues, allocated by the sender
+    struct Message : IntrusiveHook {
+        long payload{0};
+    };
+
+    // Heap allocated messages. Each thread sends operationsByThread
+    // messages and then receives as many (its own or the ones of
+    // other threads) and frees them. A node based queue allocates a
+    // node per message, an intrusive queue links the message itself
+    // and frees it with its Disposer after done().
+    template<typename Queue>
+    long message_test(int cores, int operationsByThread) {
+        Queue queue{(std::size_t) cores};
+        std::barrier sync_point(cores);
+        std::vector<std::thread> threads;
+        auto receive = [&queue] (Message* msg) {
+            if constexpr (requires { queue.done(msg); }) {
+                queue.done(msg);
+            } else {
+                delete msg;
+            }
+        };
+        std::function<void(int)> func = [&] (const int thread_id) {
+            sync_point.arrive_and_wait();
+            for (int i = 0; i < operationsByThread; i++) {
+                Message* msg = new Message();
+                msg->payload = i;
+                queue.enqueue(msg, thread_id);
+            }
+            for (int i = 0; i < operationsByThread; i++) {
+                Message* msg = queue.dequeue(thread_id);
+                if (msg != nullptr) receive(msg);
+            }
+        };
+        auto t_start = std::chrono::steady_clock::now();
+        for (int i = 0; i < cores; i++) {
+            threads.push_back(std::thread(func, i));
+        }
+        for (std::thread &th: threads) {
+            if (th.joinable()) {
+                th.join();
+            }
+        }
+        auto t_end = std::chrono::steady_clock::now();
+        Message* msg;
+        while ((msg = queue.dequeue(0)) != nullptr) receive(msg);
+        return std::chrono::duration<long, std::nano>(t_end - t_start).count();
+    };
+
+    template<typename Queue>
+    json experimentMessages(int cores, int operations) {
+        json exp_json;
+        for (int i = 1; i <= cores; i++) {
+            std::cout << "Cores: " << i << "; messages: " << operations << std::endl;
+            exp_json[std::to_string(i)]["time_ns"] = message_test<Queue>(i, operations / i);
+        }
+        return exp_json;
+    };
+
+    template<typename Queue>
+    json experimentWakeup(int consumers, int messages) {
+        json exp_json;
+        for (long gap : {10, 100, 1000}) {
+            std::cout << "Gap: " << gap << "us; consumers: " << consumers << std::endl;
+            exp_json[std::to_string(gap)]["spin"] =
+                wakeup_latency_test<Queue>(consumers, messages, std::chrono::microseconds(gap), false);
+            exp_json[std::to_string(gap)]["blocking"] =
+                wakeup_latency_test<Queue>(consumers, messages, std::chrono::microseconds(gap), true);
+        }
+        return exp_json;
+    };
+
     // Arithmetic mean obtained from the coefficient of variation
 
     // To calculate this mean, we need to have an experiment
@@ -514,6 +787,78 @@ namespace experiments {
 
 
 
+    void exp_json_wakeup(std::string name, json alg_results) {
+        json results;
+        results["algorithm"] = name;
+        results["results"] = alg_results;
+        std::cout << std::setw(4) << results << std::endl;
+        std::time_t currTime;
+        std::tm* currTm;
+        std::time(&currTime);
+        currTm = std::localtime(&currTime);
+        char buffer[256];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d-%H:%M:%S", currTm);
+        std::string fileName = "results/" + std::string(buffer) + "__" + name + "_test_wakeup_latency.json";
+        std::ofstream file(fileName);
+        file << std::setw(4) << results << std::endl;
+        file.close();
+        std::cout << fileName << std::endl;
+    };
+
+    void exp_json_empty_polling(std::string name, json alg_results) {
+        json results;
+        results["algorithm"] = name;
+        results["results"] = alg_results;
+        std::cout << std::setw(4) << results << std::endl;
+        std::time_t currTime;
+        std::tm* currTm;
+        std::time(&currTime);
+        currTm = std::localtime(&currTime);
+        char buffer[256];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d-%H:%M:%S", currTm);
+        std::string fileName = "results/" + std::string(buffer) + "__" + name + "_test_empty_polling.json";
+        std::ofstream file(fileName);
+        file << std::setw(4) << results << std::endl;
+        file.close();
+        std::cout << fileName << std::endl;
+    };
+
+    void exp_json_split(std::string name, json alg_results) {
+        json results;
+        results["algorithm"] = name;
+        results["results"] = alg_results;
+        std::cout << std::setw(4) << results << std::endl;
+        std::time_t currTime;
+        std::tm* currTm;
+        std::time(&currTime);
+        currTm = std::localtime(&currTime);
+        char buffer[256];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d-%H:%M:%S", currTm);
+        std::string fileName = "results/" + std::string(buffer) + "__" + name + "_test_split.json";
+        std::ofstream file(fileName);
+        file << std::setw(4) << results << std::endl;
+        file.close();
+        std::cout << fileName << std::endl;
+    };
+
+    void exp_json_messages(std::string name, json alg_results) {
+        json results;
+        results["algorithm"] = name;
+        results["results"] = alg_results;
+        std::cout << std::setw(4) << results << std::endl;
+        std::time_t currTime;
+        std::tm* currTm;
+        std::time(&currTime);
+        currTm = std::localtime(&currTime);
+        char buffer[256];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d-%H:%M:%S", currTm);
+        std::string fileName = "results/" + std::string(buffer) + "__" + name + "_test_messages.json";
+        std::ofstream file(fileName);
+        file << std::setw(4) << results << std::endl;
+        file.close();
+        std::cout << fileName << std::endl;
+    };
+
     void experiments() {
         const auto cores = std::thread::hardware_concurrency();
         // std::map<std::string, std::map<std::string, std::vector<long>>> results;
@@ -525,6 +870,8 @@ namespace experiments {
         exp_json("MSQUEUE", experiment<ms_queue::Queue<std::string>>(cores, operations));
         std::cout << "\n\nLCRQ-QUEUE\n\n";
         exp_json("LCRQQUEUE", experiment<lcrq_queue::Queue<std::string>>(cores, operations));
+        std::cout << "\n\nLPRQ-QUEUE\n\n";
+        exp_json("LPRQQUEUE", experiment<lprq_queue::Queue<std::string>>(cores, operations));
         std::cout << "\n\nYMC-QUEUE\n\n";
         exp_json("YMCQUEUE", experiment<ymc_queue::Queue<std::string>>(cores, operations));
         std::cout << "\n\nSBQ-QUEUE\n\n";
@@ -539,6 +886,186 @@ namespace experiments {
         exp_json("LLICQUEUE_ARRAY_2", experiment<llic_queue::FAIQueueArray2<std::string, llic_queue::LLICCAS, llic_queue::KBasketFAI<std::string, 4>>>(cores, operations));
     };
 
+    template<typename... Queues>
+    void experiments_basket_queues(llic_queue::TypeList<Queues...>, int cores, int operations) {
+        ((std::cout << "\n\n" << Queues::name() << "\n\n",
+          exp_json(Queues::name(), experiment<Queues>(cores, operations))), ...);
+    }
+
+    void experiments_modular() {
+        using namespace llic_queue;
+        const auto cores = std::thread::hardware_concurrency();
+        std::cout << "\n\nModular basket queue experiment with " << cores << " and 1'000'000 operations\n\n";
+        int operations = 1'000'000;
+        using Queues = BasketQueueProduct_t<std::string,
+                                            TypeList<LLICCAS>,
+                                            TypeList<KBasketFAI<std::string, 2>,
+                                                     KBasketFAI<std::string, 4>,
+                                                     KBasketFAI<std::string, 8>>,
+                                            TypeList<SegmentRing<1000000>, SegmentArray, LinkedSegments>,
+                                            ReclaimerList<NoReclamation, MemoryManagementPool>>;
+        experiments_basket_queues(Queues{}, cores, operations);
+    };
+
+    // Same queues with hazard pointers (symmetric and asymmetric),
+    // epoch based reclamation and hazard eras, to measure the cost of
+    // each scheme.
+    void experiments_reclamation() {
+        using namespace llic_queue;
+        const auto cores = std::thread::hardware_concurrency();
+        std::cout << "\n\nReclamation experiment with " << cores << " and 1'000'000 operations\n\n";
+        int operations = 1'000'000;
+        std::cout << "\n\nFAA-QUEUE\n\n";
+        exp_json("FAAQUEUE_HP", experiment<faa_array::Queue<std::string, MemoryManagementPool>>(cores, operations));
+        exp_json("FAAQUEUE_AHP", experiment<faa_array::Queue<std::string, AsymmetricHazardPool>>(cores, operations));
+        exp_json("FAAQUEUE_EBR", experiment<faa_array::Queue<std::string, EpochBasedReclamation>>(cores, operations));
+        exp_json("FAAQUEUE_HE", experiment<faa_array::Queue<std::string, HazardErasPool>>(cores, operations));
+        std::cout << "\n\nMS-QUEUE\n\n";
+        exp_json("MSQUEUE_HP", experiment<ms_queue::Queue<std::string, MemoryManagementPool>>(cores, operations));
+        exp_json("MSQUEUE_AHP", experiment<ms_queue::Queue<std::string, AsymmetricHazardPool>>(cores, operations));
+        exp_json("MSQUEUE_EBR", experiment<ms_queue::Queue<std::string, EpochBasedReclamation>>(cores, operations));
+        exp_json("MSQUEUE_HE", experiment<ms_queue::Queue<std::string, HazardErasPool>>(cores, operations));
+        std::cout << "\n\nLCRQ-QUEUE\n\n";
+        exp_json("LCRQQUEUE_HP", experiment<lcrq_queue::Queue<std::string, MemoryManagementPool>>(cores, operations));
+        exp_json("LCRQQUEUE_AHP", experiment<lcrq_queue::Queue<std::string, AsymmetricHazardPool>>(cores, operations));
+        exp_json("LCRQQUEUE_EBR", experiment<lcrq_queue::Queue<std::string, EpochBasedReclamation>>(cores, operations));
+        exp_json("LCRQQUEUE_HE", experiment<lcrq_queue::Queue<std::string, HazardErasPool>>(cores, operations));
+        std::cout << "\n\nLLIC-Queue-Segments\n\n";
+        exp_json("LLICQUEUE_SEGMENT_HP", experiment<Queue<std::string, LLICCAS, KBasketFAI<std::string, 4>, MemoryManagementPool>>(cores, operations));
+        exp_json("LLICQUEUE_SEGMENT_AHP", experiment<Queue<std::string, LLICCAS, KBasketFAI<std::string, 4>, AsymmetricHazardPool>>(cores, operations));
+        exp_json("LLICQUEUE_SEGMENT_EBR", experiment<Queue<std::string, LLICCAS, KBasketFAI<std::string, 4>, EpochBasedReclamation>>(cores, operations));
+        exp_json("LLICQUEUE_SEGMENT_HE", experiment<Queue<std::string, LLICCAS, KBasketFAI<std::string, 4>, HazardErasPool>>(cores, operations));
+        std::cout << "\n\nLLIC-Queue-Linked\n\n";
+        exp_json("LLICQUEUE_LINKED_HP", experiment<BasketQueue<std::string, LLICCAS, KBasketFAI<std::string, 4>, LinkedSegments, MemoryManagementPool>>(cores, operations));
+        exp_json("LLICQUEUE_LINKED_AHP", experiment<BasketQueue<std::string, LLICCAS, KBasketFAI<std::string, 4>, LinkedSegments, AsymmetricHazardPool>>(cores, operations));
+        exp_json("LLICQUEUE_LINKED_EBR", experiment<BasketQueue<std::string, LLICCAS, KBasketFAI<std::string, 4>, LinkedSegments, EpochBasedReclamation>>(cores, operations));
+        exp_json("LLICQUEUE_LINKED_HE", experiment<BasketQueue<std::string, LLICCAS, KBasketFAI<std::string, 4>, LinkedSegments, HazardErasPool>>(cores, operations));
+    };
+
+    // The queues with a Backoff policy as their only parameter, for
+    // the backoff sweep
+    template<typename B>
+    using MSQueueBackoff = ms_queue::Queue<std::string, MemoryManagementPool, B>;
+
+    template<typename B>
+    using LCRQQueueBackoff = lcrq_queue::Queue<std::string, MemoryManagementPool, B>;
+
+    template<typename B>
+    using SBQQueueBackoff = scal_basket_queue::Queue<std::string, B>;
+
+    template<typename B>
+    using LLICQueueBackoff = llic_queue::FAIQueue<std::string, llic_queue::BackoffLLICCAS<B>, llic_queue::KBasketFAI<std::string, 4>, 1000000>;
+
+    template<template<typename> class Q, typename... Backoffs>
+    void experiments_backoff_sweep(std::string prefix, llic_queue::TypeList<Backoffs...>, int cores, int operations) {
+        ((std::cout << "\n\n" << prefix << "_" << Backoffs::name() << "\n\n",
+          exp_json(prefix + "_" + Backoffs::name(), experiment<Q<Backoffs>>(cores, operations))), ...);
+    }
+
+    // Each queue with every backoff policy, the policy changes the
+    // shape of the scalability curve under contention.
+    void experiments_backoff() {
+        const auto cores = std::thread::hardware_concurrency();
+        std::cout << "\n\nBackoff experiment with " << cores << " and 1'000'000 operations\n\n";
+        int operations = 1'000'000;
+        using Backoffs = llic_queue::TypeList<NoBackoff, PauseBackoff, ExponentialBackoff<>, RandomBackoff<>, ProportionalBackoff<>>;
+        experiments_backoff_sweep<MSQueueBackoff>("MSQUEUE", Backoffs{}, cores, operations);
+        experiments_backoff_sweep<LCRQQueueBackoff>("LCRQQUEUE", Backoffs{}, cores, operations);
+        experiments_backoff_sweep<SBQQueueBackoff>("SBQQUEUE", Backoffs{}, cores, operations);
+        experiments_backoff_sweep<LLICQueueBackoff>("LLICQUEUE", Backoffs{}, cores, operations);
+    };
+
+    void experiments_wakeup() {
+        using blocking_queue::BlockingQueue;
+        const int consumers = std::max(1u, std::thread::hardware_concurrency() - 1);
+        std::cout << "\n\nWakeup latency experiment with " << consumers << " consumers and 2'000 messages\n\n";
+        int messages = 2'000;
+        std::cout << "\n\nFAA-QUEUE\n\n";
+        exp_json_wakeup("FAAQUEUE", experimentWakeup<BlockingQueue<WakeupMessage, faa_array::Queue<WakeupMessage>>>(consumers, messages));
+        std::cout << "\n\nLCRQ-QUEUE\n\n";
+        exp_json_wakeup("LCRQQUEUE", experimentWakeup<BlockingQueue<WakeupMessage, lcrq_queue::Queue<WakeupMessage>>>(consumers, messages));
+        std::cout << "\n\nYMC-QUEUE\n\n";
+        exp_json_wakeup("YMCQUEUE", experimentWakeup<BlockingQueue<WakeupMessage, ymc_queue::Queue<WakeupMessage>>>(consumers, messages));
+        std::cout << "\n\nLLIC-QUEUE\n\n";
+        exp_json_wakeup("LLICQUEUE", experimentWakeup<BlockingQueue<WakeupMessage, llic_queue::FAIQueue<WakeupMessage, llic_queue::LLICCAS, llic_queue::KBasketFAI<WakeupMessage, 4>, 1000000>>>(consumers, messages));
+    };
+
+    void experiments_empty_polling() {
+        const int pollers = std::max(1u, std::thread::hardware_concurrency() - 1);
+        std::cout << "\n\nEmpty polling experiment with up to " << pollers << " pollers and 1'000'000 items\n\n";
+        int items = 1'000'000;
+        std::cout << "\n\nFAA-QUEUE\n\n";
+        exp_json_empty_polling("FAAQUEUE", experimentEmptyPolling<faa_array::Queue<std::string>>(pollers, items));
+        std::cout << "\n\nMS-QUEUE\n\n";
+        exp_json_empty_polling("MSQUEUE", experimentEmptyPolling<ms_queue::Queue<std::string>>(pollers, items));
+        std::cout << "\n\nLCRQ-QUEUE\n\n";
+        exp_json_empty_polling("LCRQQUEUE", experimentEmptyPolling<lcrq_queue::Queue<std::string>>(pollers, items));
+        std::cout << "\n\nLPRQ-QUEUE\n\n";
+        exp_json_empty_polling("LPRQQUEUE", experimentEmptyPolling<lprq_queue::Queue<std::string>>(pollers, items));
+        std::cout << "\n\nYMC-QUEUE\n\n";
+        exp_json_empty_polling("YMCQUEUE", experimentEmptyPolling<ymc_queue::Queue<std::string>>(pollers, items));
+        std::cout << "\n\nSBQ-QUEUE\n\n";
+        exp_json_empty_polling("SBQQUEUE", experimentEmptyPolling<scal_basket_queue::Queue<std::string>>(pollers, items));
+        std::cout << "\n\nLLIC-QUEUE\n\n";
+        exp_json_empty_polling("LLICQUEUE", experimentEmptyPolling<llic_queue::FAIQueue<std::string, llic_queue::LLICCAS, llic_queue::KBasketFAI<std::string, 4>, 1000000>>(pollers, items));
+    };
+
+    // Queues specialized for one consumer (MPSC) and for one producer
+    // (SPMC), each one next to the general queue in the same split.
+    void experiments_roles() {
+        using namespace llic_queue;
+        const int threads = std::max(1u, std::thread::hardware_concurrency() - 1);
+        std::cout << "\n\nProducers/consumers split experiment with up to " << threads << " threads on one side and 1'000'000 items\n\n";
+        int items = 1'000'000;
+        using LLICQueueMPMC = FAIQueue<std::string, LLICCAS, KBasketFAI<std::string, 4>, 1000000>;
+        using LLICQueueMPSC = FAIQueueMPSC<std::string, LLICCAS, KBasketFAI<std::string, 4>, 1000000>;
+        using LLICQueueSPMC = FAIQueueSPMC<std::string, LLICCAS, KBasketFAI<std::string, 4>, 1000000>;
+        std::cout << "\n\nFAA-QUEUE\n\n";
+        exp_json_split("FAAQUEUE_MPMC_MANY_PRODUCERS", experimentSplit<faa_array::Queue<std::string>>(threads, items, true));
+        exp_json_split("FAAQUEUE_MPSC", experimentSplit<faa_array::MPSCQueue<std::string>>(threads, items, true));
+        exp_json_split("FAAQUEUE_MPMC_MANY_CONSUMERS", experimentSplit<faa_array::Queue<std::string>>(threads, items, false));
+        exp_json_split("FAAQUEUE_SPMC", experimentSplit<faa_array::SPMCQueue<std::string>>(threads, items, false));
+        std::cout << "\n\nLLIC-QUEUE\n\n";
+        exp_json_split("LLICQUEUE_MPMC_MANY_PRODUCERS", experimentSplit<LLICQueueMPMC>(threads, items, true));
+        exp_json_split("LLICQUEUE_MPSC", experimentSplit<LLICQueueMPSC>(threads, items, true));
+        exp_json_split("LLICQUEUE_MPMC_MANY_CONSUMERS", experimentSplit<LLICQueueMPMC>(threads, items, false));
+        exp_json_split("LLICQUEUE_SPMC", experimentSplit<LLICQueueSPMC>(threads, items, false));
+    };
+
+    // One producer and one consumer. The SPSC ring is the floor of
+    // the battery, the MPMC queues in the same link measure the cost
+    // of their synchronization.
+    void experiments_spsc() {
+        int items = 10'000'000;
+        std::cout << "\n\nSPSC link experiment with 10'000'000 items\n\n";
+        std::cout << "\n\nSPSC-QUEUE\n\n";
+        exp_json_split("SPSCQUEUE", experimentSplit<spsc_queue::Queue<std::string>>(1, items, true));
+        std::cout << "\n\nFAA-QUEUE\n\n";
+        exp_json_split("FAAQUEUE_SPSC_LINK", experimentSplit<faa_array::Queue<std::string>>(1, items, true));
+        std::cout << "\n\nMS-QUEUE\n\n";
+        exp_json_split("MSQUEUE_SPSC_LINK", experimentSplit<ms_queue::Queue<std::string>>(1, items, true));
+        std::cout << "\n\nLCRQ-QUEUE\n\n";
+        exp_json_split("LCRQQUEUE_SPSC_LINK", experimentSplit<lcrq_queue::Queue<std::string>>(1, items, true));
+        std::cout << "\n\nLLIC-QUEUE\n\n";
+        exp_json_split("LLICQUEUE_SPSC_LINK", experimentSplit<llic_queue::FAIQueueLinked<std::string, llic_queue::LLICCAS, llic_queue::KBasketFAI<std::string, 4>>>(1, items, true));
+    };
+
+    // Michael-Scott queue with a node per message against the
+    // intrusive one, with each reclaimer.
+    void experiments_intrusive() {
+        const auto cores = std::thread::hardware_concurrency();
+        std::cout << "\n\nIntrusive queue experiment with " << cores << " and 1'000'000 messages\n\n";
+        int operations = 1'000'000;
+        std::cout << "\n\nMS-QUEUE\n\n";
+        exp_json_messages("MSQUEUE_HP", experimentMessages<ms_queue::Queue<Message, MemoryManagementPool>>(cores, operations));
+        exp_json_messages("MSQUEUE_EBR", experimentMessages<ms_queue::Queue<Message, EpochBasedReclamation>>(cores, operations));
+        exp_json_messages("MSQUEUE_HE", experimentMessages<ms_queue::Queue<Message, HazardErasPool>>(cores, operations));
+        std::cout << "\n\nMS-QUEUE-INTRUSIVE\n\n";
+        exp_json_messages("MSQUEUE_INTRUSIVE_HP", experimentMessages<ms_queue::IntrusiveQueue<Message, std::default_delete<Message>, MemoryManagementPool>>(cores, operations));
+        exp_json_messages("MSQUEUE_INTRUSIVE_EBR", experimentMessages<ms_queue::IntrusiveQueue<Message, std::default_delete<Message>, EpochBasedReclamation>>(cores, operations));
+        exp_json_messages("MSQUEUE_INTRUSIVE_HE", experimentMessages<ms_queue::IntrusiveQueue<Message, std::default_delete<Message>, HazardErasPool>>(cores, operations));
+    };
+
     void experiments_only_enq() {
         const auto cores = std::thread::hardware_concurrency();
         // std::map<std::string, std::map<std::string, std::vector<long>>> results;
@@ -550,6 +1077,8 @@ namespace experiments {
         // exp_json_only_enq("MSQUEUE", experimentOnlyEnq<ms_queue::Queue<std::string>>(cores, operations));
         // std::cout << "\n\nLCRQ-QUEUE\n\n";
         // exp_json_only_enq("LCRQQUEUE", experimentOnlyEnq<lcrq_queue::Queue<std::string>>(cores, operations));
+        // std::cout << "\n\nLPRQ-QUEUE\n\n";
+        // exp_json_only_enq("LPRQQUEUE", experimentOnlyEnq<lprq_queue::Queue<std::string>>(cores, operations));
         // std::cout << "\n\nYMC-QUEUE\n\n";
         // exp_json_only_enq("YMCQUEUE", experimentOnlyEnq<ymc_queue::Queue<std::string>>(cores, operations));
         // std::cout << "\n\nSBQ-QUEUE\n\n";
@@ -575,6 +1104,8 @@ namespace experiments {
         // exp_json_only_deq("MSQUEUE", experimentOnlyDeq<ms_queue::Queue<std::string>>(cores, operations));
         // std::cout << "\n\nLCRQ-QUEUE\n\n";
         // exp_json_only_deq("LCRQQUEUE", experimentOnlyDeq<lcrq_queue::Queue<std::string>>(cores, operations));
+        // std::cout << "\n\nLPRQ-QUEUE\n\n";
+        // exp_json_only_deq("LPRQQUEUE", experimentOnlyDeq<lprq_queue::Queue<std::string>>(cores, operations));
         // std::cout << "\n\nYMC-QUEUE\n\n";
         // exp_json_only_deq("YMCQUEUE", experimentOnlyDeq<ymc_queue::Queue<std::string>>(cores, operations));
         // std::cout << "\n\nSBQ-QUEUE\n\n";
@@ -2,30 +2,53 @@
 #define _FAA_ARRAY_QUEUE_HPP_
 
 #include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <span>
 #include <stdexcept>
 #include <cassert>
 #include "MemoryManagementPool.hpp"
+#include "Cells.hpp"
+#include "Roles.hpp"
+#include "ThreadHandle.hpp"
 
 namespace faa_array {
     static constexpr int NODE_POW = 10;
     static constexpr std::size_t BUFFER_SIZE = 1ull<<NODE_POW;
     static constexpr int MAX_THREADS = 64;
 
-    template <typename T>
-    class Queue {
+    // Cell selects what the slots store (see Cells.hpp): T* by
+    // default, or 32-bit values with CompactCell. Producer and
+    // Consumer give the number of threads of each side (see
+    // Roles.hpp): a Single side moves its index of the node and its
+    // end of the list (tail, head) with loads and stores.
+    template <typename T, template<typename> class Reclaimer = MemoryManagementPool,
+              typename Cell = PointerCell<T>,
+              typename Producer = ProducerPolicy::Multi, typename Consumer = ConsumerPolicy::Multi>
+    class Queue : public ThreadRegistration<Queue<T, Reclaimer, Cell, Producer, Consumer>> {
 
     private:
+        using Value = typename Cell::value_type;
+
         struct Node {
             std::atomic<int>   deqIdx;
             std::atomic<int>   enqIdx;
             std::atomic<Node*> next;
-            std::atomic<T*>    items[BUFFER_SIZE];
+            std::atomic<Value> items[BUFFER_SIZE];
+            uint64_t           birthEra{0};
+            uint64_t           id{0}; // Position in the list, set before linking
 
 
-            Node(T* item): deqIdx{0}, enqIdx{1}, next{nullptr} {
+            Node(Value item): deqIdx{0}, enqIdx{1}, next{nullptr} {
                 items[0].store(item, std::memory_order_relaxed);
                 for (std::size_t i = 1; i < BUFFER_SIZE; i++) {
-                    items[i].store(nullptr, std::memory_order_relaxed);
+                    items[i].store(Cell::null(), std::memory_order_relaxed);
+                }
+            }
+
+            Node(std::span<Value> first): deqIdx{0}, enqIdx{(int) first.size()}, next{nullptr} {
+                for (std::size_t i = 0; i < BUFFER_SIZE; i++) {
+                    items[i].store(i < first.size() ? first[i] : Cell::null(), std::memory_order_relaxed);
                 }
             }
         };
@@ -34,47 +57,95 @@ namespace faa_array {
         alignas(128) std::atomic<Node*> tail;
 
         std::size_t maxThreads;
-        T* taken = (T*) new int();
-        MemoryManagementPool<Node> mm;
+        Reclaimer<Node> mm;
+        // Thread id, with the row of mm when it keeps one (see ThreadHandle.hpp)
+        using Thread = thread_ref_t<Reclaimer<Node>>;
+
+        static Value taken() {
+            return Cell::marker(0);
+        }
+
+        // Reserves n slots of enqIdx or deqIdx. The thread of a Single
+        // side owns its index, so a load and a store replace the
+        // fetch&add. The slots are still claimed with CAS (enqueue)
+        // and exchange (dequeue), the other side may reach them.
+        template<typename Role>
+        static std::size_t reserve(std::atomic<int>& idx, int n) {
+            if constexpr (Role::single) {
+                int i = idx.load(std::memory_order_relaxed);
+                idx.store(i + n, std::memory_order_release);
+                return i;
+            } else {
+                return idx.fetch_add(n);
+            }
+        }
+
+        // Moves an end of the list from expected to next. Only the
+        // thread of a Single side moves its end.
+        template<typename Role>
+        static bool advance(std::atomic<Node*>& end, Node*& expected, Node* next) {
+            if constexpr (Role::single) {
+                end.store(next, std::memory_order_release);
+                return true;
+            } else {
+                return end.compare_exchange_strong(expected, next);
+            }
+        }
 
 
     public:
         Queue(std::size_t maxThreads=MAX_THREADS): maxThreads(maxThreads) {
-            Node* sentinel = new Node(nullptr);
+            Node* sentinel = new Node(Cell::null());
             sentinel->enqIdx.store(0, std::memory_order_relaxed);
             head.store(sentinel, std::memory_order_relaxed);
             tail.store(sentinel, std::memory_order_relaxed);
         }
 
         ~Queue() {
-            while (dequeue(0) != nullptr);
+            while (dequeue(0) != Cell::null());
             delete head.load();
-            delete (int*) taken;
         }
 
-        void enqueue(T* item, std::size_t thread_id) {
-            assert(item != nullptr && "Elemento a insertar no puede ser nullptr");
+        // Called by a thread that will not use the queue anymore
+        void release(std::size_t thread_id) {
+            mm.release(thread_id);
+        }
+
+        using ThreadRegistration<Queue>::enqueue;
+        using ThreadRegistration<Queue>::dequeue;
+        using ThreadRegistration<Queue>::approx_size;
+        using ThreadRegistration<Queue>::enqueue_bulk;
+        using ThreadRegistration<Queue>::dequeue_bulk;
+
+        // Called once by the handle of each thread
+        Thread thread_ref(const int thread_id) {
+            return ::thread_ref(mm, thread_id);
+        }
+
+        void enqueue(Value item, Thread thread_id) {
+            assert(Cell::valid(item) && "Elemento a insertar no puede ser nulo ni reservado");
             Node* nullValue = nullptr;
             while (true) {
                 Node* ltail = mm.protect(0, tail, thread_id);
-                std::size_t idx = ltail->enqIdx.fetch_add(1);
+                std::size_t idx = reserve<Producer>(ltail->enqIdx, 1);
                 if (idx > BUFFER_SIZE - 1) {
                     if (ltail != tail.load()) continue;
                     Node* lnext = ltail->next.load();
                     if (lnext == nullptr) {
-                        Node* newNode = new Node(item);
+                        Node* newNode = mm.allocate(thread_id, item);
+                        newNode->id = ltail->id + 1;
                         if (ltail->next.compare_exchange_strong(nullValue, newNode)) {
-                            tail.compare_exchange_strong(ltail, newNode);
+                            advance<Producer>(tail, ltail, newNode);
                             mm.clear(thread_id);
                             return;
                         }
                         delete newNode;
                     } else {
-                        tail.compare_exchange_strong(ltail, lnext);
+                        advance<Producer>(tail, ltail, lnext);
                     }
                     continue;
                 }
-                T* itemnull = nullptr;
+                Value itemnull = Cell::null();
                 if (ltail->items[idx].compare_exchange_strong(itemnull, item)) {
                     mm.clear(thread_id);
                     return;
@@ -82,30 +153,127 @@ namespace faa_array {
             }
         }
 
-        T* dequeue(std::size_t thread_id) {
+        Value dequeue(Thread thread_id) {
             while (true) {
                 Node* lhead = mm.protect(0, head, thread_id);
                 if (lhead->deqIdx.load() >= lhead->enqIdx.load() && lhead->next.load() == nullptr) break;
-                std::size_t idx = lhead->deqIdx.fetch_add(1);
+                std::size_t idx = reserve<Consumer>(lhead->deqIdx, 1);
                 if (idx > (BUFFER_SIZE - 1)) {
                     Node* lnext = lhead->next.load();
                     if (lnext == nullptr) break;
-                    if (head.compare_exchange_strong(lhead, lnext)) {
+                    if (advance<Consumer>(head, lhead, lnext)) {
                         mm.retire(lhead, thread_id);
                     }
                     continue;
                 }
-                T* item = lhead->items[idx].exchange(taken);
-                if (item == nullptr) continue;
+                Value item = lhead->items[idx].exchange(taken());
+                if (item == Cell::null()) continue;
                 mm.clear(thread_id);
                 return item;
             }
             mm.clear(thread_id);
-            return nullptr;
+            return Cell::null();
+        }
+
+        // Items between HEAD and TAIL, from the node ids and indices,
+        // without writing shared state (only the hazard pointers of
+        // the caller). Exact when no operation is running, otherwise
+        // off by at most the items of the operations running
+        // concurrently: the two ends are read at different times and
+        // an index may be reserved by an operation not yet finished.
+        std::size_t approx_size(Thread thread_id) {
+            Node* lhead = mm.protect(0, head, thread_id);
+            uint64_t first = lhead->id * BUFFER_SIZE + std::min<uint64_t>(lhead->deqIdx.load(), BUFFER_SIZE);
+            Node* ltail = mm.protect(1, tail, thread_id);
+            uint64_t last = ltail->id * BUFFER_SIZE + std::min<uint64_t>(ltail->enqIdx.load(), BUFFER_SIZE);
+            mm.clear(thread_id);
+            return last > first ? last - first : 0;
+        }
+
+        // Reserves a contiguous range of slots with one fetch&add. If
+        // a slot was already taken by a dequeuer, the remaining items
+        // go to a new range, so they keep their order.
+        void enqueue_bulk(std::span<Value> items, Thread thread_id) {
+            Node* nullValue = nullptr;
+            while (!items.empty()) {
+                Node* ltail = mm.protect(0, tail, thread_id);
+                std::size_t enq = ltail->enqIdx.load();
+                std::size_t m = enq < BUFFER_SIZE ? std::min(items.size(), BUFFER_SIZE - enq) : 1;
+                std::size_t idx = reserve<Producer>(ltail->enqIdx, m);
+                if (idx > BUFFER_SIZE - 1) {
+                    if (ltail != tail.load()) continue;
+                    Node* lnext = ltail->next.load();
+                    if (lnext == nullptr) {
+                        std::size_t n = std::min(items.size(), BUFFER_SIZE);
+                        Node* newNode = mm.allocate(thread_id, items.first(n));
+                        newNode->id = ltail->id + 1;
+                        if (ltail->next.compare_exchange_strong(nullValue, newNode)) {
+                            advance<Producer>(tail, ltail, newNode);
+                            items = items.subspan(n);
+                            continue;
+                        }
+                        nullValue = nullptr;
+                        delete newNode;
+                    } else {
+                        advance<Producer>(tail, ltail, lnext);
+                    }
+                    continue;
+                }
+                std::size_t end = std::min(idx + m, BUFFER_SIZE);
+                for (; idx < end; idx++) {
+                    Value itemnull = Cell::null();
+                    if (!ltail->items[idx].compare_exchange_strong(itemnull, items.front())) break;
+                    items = items.subspan(1);
+                }
+            }
+            mm.clear(thread_id);
+        }
+
+        // Reserves up to max slots already claimed by enqueuers with
+        // one fetch&add. Returns the number of items taken, 0 if the
+        // queue is empty.
+        std::size_t dequeue_bulk(std::span<Value> items, std::size_t max, Thread thread_id) {
+            max = std::min(max, items.size());
+            std::size_t count = 0;
+            while (count < max) {
+                Node* lhead = mm.protect(0, head, thread_id);
+                std::size_t deq = lhead->deqIdx.load();
+                std::size_t enq = lhead->enqIdx.load();
+                if (deq >= enq && lhead->next.load() == nullptr) break;
+                std::size_t available = std::min(enq, BUFFER_SIZE);
+                std::size_t m = available > deq ? std::min(available - deq, max - count) : 1;
+                std::size_t idx = reserve<Consumer>(lhead->deqIdx, m);
+                if (idx > (BUFFER_SIZE - 1)) {
+                    Node* lnext = lhead->next.load();
+                    if (lnext == nullptr) break;
+                    if (advance<Consumer>(head, lhead, lnext)) {
+                        mm.retire(lhead, thread_id);
+                    }
+                    continue;
+                }
+                std::size_t end = std::min(idx + m, BUFFER_SIZE);
+                for (; idx < end; idx++) {
+                    Value item = lhead->items[idx].exchange(taken());
+                    if (item != Cell::null()) items[count++] = item;
+                }
+            }
+            mm.clear(thread_id);
+            return count;
         }
 
     };
 
+    // Many producers and one consumer, and the reverse
+    template<typename T, template<typename> class Reclaimer = MemoryManagementPool>
+    using MPSCQueue = Queue<T, Reclaimer, PointerCell<T>, ProducerPolicy::Multi, ConsumerPolicy::Single>;
+
+    template<typename T, template<typename> class Reclaimer = MemoryManagementPool>
+    using SPMCQueue = Queue<T, Reclaimer, PointerCell<T>, ProducerPolicy::Single, ConsumerPolicy::Multi>;
+
+    // Cells of 4 bytes holding the values themselves
+    template<template<typename> class Reclaimer = MemoryManagementPool>
+    using CompactQueue = Queue<uint32_t, Reclaimer, CompactCell>;
+
 }
 
 #endif
@@ -2,14 +2,21 @@
 #define _HP_Queue_HPP_
 
 #include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
 #include "MemoryManagementPool.hpp"
+#include "Backoff.hpp"
+#include "Intrusive.hpp"
+#include "ThreadHandle.hpp"
 
-template <typename T>
-class Queue {
+template <typename T, typename Backoff = NoBackoff>
+class Queue : public ThreadRegistration<Queue<T, Backoff>> {
 private:
     struct Node {
         T* data;
         std::atomic<Node*> next{nullptr};
+        uint64_t index{0}; // Position in the list, set before linking
 
         Node() {
         }
@@ -27,17 +34,29 @@ private:
     alignas(128) std::atomic<Node*> Head = dummy;
     alignas(128) std::atomic<Node*> Tail = dummy;
     MemoryManagementPool<Node> mm;
+    // Thread id with the row of mm, see ThreadHandle.hpp
+    using Thread = typename MemoryManagementPool<Node>::Thread;
 
 public:
     Queue() {}
 
     Queue(T defaultVal) : defaultValue(defaultVal) {}
 
-    void enqueue(T* data, const int thread_id) {
+    using ThreadRegistration<Queue>::enqueue;
+    using ThreadRegistration<Queue>::dequeue;
+    using ThreadRegistration<Queue>::approx_size;
+
+    // Called once by the handle of each thread
+    Thread thread_ref(const int thread_id) {
+        return ::thread_ref(mm, thread_id);
+    }
+
+    void enqueue(T* data, Thread thread_id) {
         Node* node = new Node(data);
         Node* t = nullptr;
         Node* next = nullptr;
         Node* null = nullptr;
+        static thread_local Backoff backoff;
         while (true) {
 
             t = mm.protectPointer(0, Tail.load(), thread_id);
@@ -48,16 +67,30 @@ public:
                 Tail.compare_exchange_strong(t, next);
                 continue;
             }
+            node->index = t->index + 1;
             if (Tail.load()->next.compare_exchange_strong(null, node)) break;
+            backoff();
         }
+        backoff.reset();
         Tail.compare_exchange_strong(t, node);
     }
 
-    T* dequeue(const int thread_id) {
+    // Nodes between Head and Tail, see ms_queue::Queue::approx_size
+    std::size_t approx_size(Thread thread_id) {
+        Node* h = mm.protect(0, Head, thread_id);
+        uint64_t first = h->index;
+        Node* t = mm.protect(1, Tail, thread_id);
+        uint64_t last = t->index;
+        mm.clear(thread_id);
+        return last > first ? last - first : 0;
+    }
+
+    T* dequeue(Thread thread_id) {
         T* data;
         Node* h = nullptr;
         Node* t = nullptr;
         Node* next = nullptr;
+        static thread_local Backoff backoff;
         while (true) {
             h = Head.load();
             h = mm.protectPointer(0, h, thread_id);
@@ -73,10 +106,125 @@ public:
             }
             data = next->data;
             if (Head.compare_exchange_strong(h, next)) break;
+            backoff();
         }
+        backoff.reset();
         mm.retire(h, thread_id);
         return data;
     }
 };
 
+// Intrusive version of Queue, T derives from IntrusiveHook (see
+// Intrusive.hpp). The sentinel is a hook owned by the queue, dequeue
+// returns nullptr when the queue is empty and the consumer calls
+// done(item) when it is finished with the item.
+template <typename T, typename Disposer = std::default_delete<T>, typename Backoff = NoBackoff>
+class IntrusiveQueue : public ThreadRegistration<IntrusiveQueue<T, Disposer, Backoff>> {
+private:
+    static_assert(std::is_base_of_v<IntrusiveHook, T>, "T debe derivar de IntrusiveHook");
+
+    using Node = IntrusiveHook;
+
+    Node dummy;
+
+    alignas(128) std::atomic<Node*> Head = &dummy;
+    alignas(128) std::atomic<Node*> Tail = &dummy;
+    MemoryManagementPool<Node> mm;
+    // Thread id with the row of mm, see ThreadHandle.hpp
+    using Thread = typename MemoryManagementPool<Node>::Thread;
+
+    static void disposeItem(Node* node) {
+        Disposer{}(static_cast<T*>(node));
+    }
+
+public:
+    IntrusiveQueue() {}
+
+    ~IntrusiveQueue() {
+        T* item;
+        while ((item = dequeue(0)) != nullptr) done(item);
+        Head.load()->dispose();
+    }
+
+    using ThreadRegistration<IntrusiveQueue>::enqueue;
+    using ThreadRegistration<IntrusiveQueue>::dequeue;
+    using ThreadRegistration<IntrusiveQueue>::approx_size;
+
+    // Called once by the handle of each thread
+    Thread thread_ref(const int thread_id) {
+        return ::thread_ref(mm, thread_id);
+    }
+
+    void enqueue(T* data, Thread thread_id) {
+        Node* node = data;
+        node->link(&disposeItem);
+        Node* t = nullptr;
+        Node* next = nullptr;
+        Node* null = nullptr;
+        static thread_local Backoff backoff;
+        while (true) {
+
+            t = mm.protectPointer(0, Tail.load(), thread_id);
+            if (Tail.load() != t) continue;
+            next = t->next.load();
+            if (Tail.load() != t) continue;
+            if (next != nullptr) {
+                Tail.compare_exchange_strong(t, next);
+                continue;
+            }
+            node->index = t->index + 1;
+            if (t->next.compare_exchange_strong(null, node)) break;
+            backoff();
+        }
+        backoff.reset();
+        Tail.compare_exchange_strong(t, node);
+        mm.clear(thread_id);
+    }
+
+    // Nodes between Head and Tail, see ms_queue::Queue::approx_size
+    std::size_t approx_size(Thread thread_id) {
+        Node* h = mm.protect(0, Head, thread_id);
+        uint64_t first = h->index;
+        Node* t = mm.protect(1, Tail, thread_id);
+        uint64_t last = t->index;
+        mm.clear(thread_id);
+        return last > first ? last - first : 0;
+    }
+
+    // Drops the reference of the consumer to a dequeued item
+    void done(T* item) {
+        item->dispose();
+    }
+
+    T* dequeue(Thread thread_id) {
+        Node* h = nullptr;
+        Node* t = nullptr;
+        Node* next = nullptr;
+        static thread_local Backoff backoff;
+        while (true) {
+            h = Head.load();
+            h = mm.protectPointer(0, h, thread_id);
+            if (Head.load() != h) continue;
+            t = Tail.load();
+            next = h->next.load();
+            next = mm.protectPointer(1, next, thread_id);
+            if (Head.load() != h) continue;
+            if (next == nullptr) {
+                mm.clear(thread_id);
+                return nullptr;
+            }
+            if (h == t) {
+                Tail.compare_exchange_strong(t, next);
+                continue;
+            }
+            if (Head.compare_exchange_strong(h, next)) break;
+            backoff();
+        }
+        backoff.reset();
+        mm.clear(thread_id);
+        if (h != &dummy) mm.retire(h, thread_id);
+        return static_cast<T*>(next);
+    }
+};
+
 #endif
@@ -0,0 +1,166 @@
+#ifndef _Hazard_Eras_Pool_HPP_
+#define _Hazard_Eras_Pool_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ThreadRegistry.hpp"
+#include "Intrusive.hpp"
+
+
+// Hazard eras reclamation with the same interface as
+// MemoryManagementPool.
+
+// Instead of the pointer, a thread publishes the era (the value of a
+// global clock) in which it read the pointer. Every object carries
+// the era in which it was allocated (birthEra, stamped by allocate)
+// and the pool records the era in which it was retired. An object
+// can be deleted when no published era falls inside its
+// [birthEra, retireEra] interval.
+
+// - protect only stores (with a full fence) when the clock has
+//   changed since the last publication, so most reads cost a load of
+//   the clock, like EBR.
+// - A stalled thread only keeps the objects that were alive in its
+//   era, so the memory stays bounded, like hazard pointers.
+
+// T must have a uint64_t birthEra member. Objects created with new
+// instead of allocate keep birthEra = 0, which is safe but keeps
+// them longer.
+
+// As in MemoryManagementPool, the state of each thread is a row of a
+// ThreadRegistry and the scans only visit the registered threads.
+
+template <typename T>
+class HazardErasPool {
+private:
+    static const int HE_THREADS_MAX = 64;
+    static const int HE_K_MAX = 4;
+    static const uint64_t NONE = 0;
+
+    struct Retired {
+        T* obj;
+        uint64_t birthEra;
+        uint64_t retireEra;
+    };
+
+    // State of one thread, registered on its first operation
+    struct alignas(128) Row {
+        std::atomic<uint64_t> he[HE_K_MAX]{};
+        std::vector<Retired> retired;
+        std::vector<uint64_t> eras; // Scan buffer
+    };
+
+    alignas(128) std::atomic<uint64_t> eraClock{1};
+    ThreadRegistry<Row> registry;
+
+    const int max_HE;
+    const int max_Threads;
+    const std::size_t threshold;
+
+    // True if some published era is inside [birth, retire]
+    static bool isProtected(const std::vector<uint64_t>& snapshot, const Retired& r) {
+        auto it = std::lower_bound(snapshot.begin(), snapshot.end(), r.birthEra);
+        return it != snapshot.end() && *it <= r.retireEra;
+    }
+
+public:
+    HazardErasPool(int max_HE = HE_K_MAX, int max_threads = HE_THREADS_MAX) :
+        max_HE(max_HE), max_Threads(max_threads), threshold(2 * (max_threads * HE_K_MAX)) {
+        assert(max_HE <= HE_K_MAX && "Demasiados hazard eras por hilo");
+    }
+
+    ~HazardErasPool() {
+        registry.forEach([](Row& row) {
+            for (Retired& r : row.retired) {
+                dispose_object(r.obj);
+            }
+        });
+    }
+
+    static std::string name() {
+        return "HE";
+    }
+
+    template<typename... Args>
+    T* allocate(const int thread_id, Args&&... args) {
+        (void) thread_id;
+        T* obj = new T(std::forward<Args>(args)...);
+        obj->birthEra = eraClock.load(std::memory_order_acquire);
+        return obj;
+    }
+
+    void clear(const int thread_id) {
+        Row& row = registry.get(thread_id);
+        for (int ihe = 0; ihe < max_HE; ihe++) {
+            row.he[ihe].store(NONE, std::memory_order_release);
+        }
+    }
+
+    void clearOne(int he_idx, const int thread_id) {
+        registry.get(thread_id).he[he_idx].store(NONE, std::memory_order_release);
+    }
+
+    // The thread leaves the pool, see MemoryManagementPool::release
+    void release(const int thread_id) {
+        clear(thread_id);
+        registry.release(thread_id);
+    }
+
+    T* protect(int he_idx, const std::atomic<T*>& atom, const int thread_id) {
+        std::atomic<uint64_t>& slot = registry.get(thread_id).he[he_idx];
+        uint64_t prevEra = slot.load(std::memory_order_relaxed);
+        while (true) {
+            T* ret = atom.load();
+            uint64_t era = eraClock.load(std::memory_order_acquire);
+            if (era == prevEra) return ret;
+            slot.store(era, std::memory_order_seq_cst);
+            prevEra = era;
+        }
+    }
+
+    // The pointer must have been read before the call, and the caller
+    // validates it afterwards, as with hazard pointers.
+    T* protectPointer(int he_idx, T* pointer, const int thread_id) {
+        std::atomic<uint64_t>& slot = registry.get(thread_id).he[he_idx];
+        uint64_t era = eraClock.load(std::memory_order_acquire);
+        if (slot.load(std::memory_order_relaxed) != era) {
+            slot.store(era, std::memory_order_seq_cst);
+        }
+        return pointer;
+    }
+
+    bool retire(T* ptr, const int thread_id) {
+        Row& row = registry.get(thread_id);
+        std::vector<Retired>& retired = row.retired;
+        retired.push_back({ptr, ptr->birthEra, eraClock.load()});
+        eraClock.fetch_add(1);
+        if (retired.size() < threshold) return false;
+        std::vector<uint64_t>& snapshot = row.eras;
+        snapshot.clear();
+        registry.forEachLive([&snapshot, this](Row& other) {
+            for (int ihe = 0; ihe < max_HE; ihe++) {
+                uint64_t era = other.he[ihe].load();
+                if (era != NONE) snapshot.push_back(era);
+            }
+        });
+        std::sort(snapshot.begin(), snapshot.end());
+        std::size_t kept = 0;
+        for (Retired& r : retired) {
+            if (isProtected(snapshot, r)) {
+                retired[kept++] = r;
+            } else {
+                dispose_object(r.obj);
+            }
+        }
+        retired.resize(kept);
+        return true;
+    }
+
+};
+
+#endif
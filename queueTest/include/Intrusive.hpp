@@ -0,0 +1,64 @@
+#ifndef _Intrusive_HPP_
+#define _Intrusive_HPP_
+
+#include <atomic>
+#include <cstdint>
+
+
+// Support for the intrusive queues, whose nodes are the items
+// themselves: the item type derives from IntrusiveHook, so enqueue
+// links the item without allocating a node.
+
+// A dequeued item stays in the queue as its sentinel until the next
+// dequeue, and after that other threads may still read its hook, so
+// the queue can not give its memory back when it is dequeued. A
+// linked item has two references:
+
+// - The one of the queue. The hook is retired to the reclaimer as any
+//   node, and when no thread can reach it the reclaimer disposes it
+//   instead of deleting it.
+// - The one of the consumer, dropped with done(item) when it is
+//   finished with the item returned by dequeue.
+
+// The last one calls the function installed by the queue, which hands
+// the item to the Disposer of the queue. An item can be enqueued
+// again only after it was disposed.
+
+struct IntrusiveHook {
+    std::atomic<IntrusiveHook*> next{nullptr};
+    std::atomic<int> refs{0};
+    uint64_t birthEra{0};
+    uint64_t index{0}; // Position in the list, set before linking
+    void (*disposer)(IntrusiveHook*){nullptr};
+
+    // Called by the queue before linking the hook
+    void link(void (*d)(IntrusiveHook*)) {
+        next.store(nullptr, std::memory_order_relaxed);
+        refs.store(2, std::memory_order_relaxed);
+        birthEra = 0;
+        disposer = d;
+    }
+
+    // Drops one reference. The sentinel owned by a queue has no
+    // disposer.
+    void dispose() {
+        if (disposer != nullptr && refs.fetch_sub(1) == 1) disposer(this);
+    }
+};
+
+// What a reclaimer does with an object that no thread can reach
+// anymore: it is deleted, unless its type has a dispose() member
+// (the hooks above), whose memory does not belong to the reclaimer.
+template<typename T>
+constexpr bool is_disposable_v = requires(T* obj) { obj->dispose(); };
+
+template<typename T>
+void dispose_object(T* obj) {
+    if constexpr (is_disposable_v<T>) {
+        obj->dispose();
+    } else {
+        delete obj;
+    }
+}
+
+#endif
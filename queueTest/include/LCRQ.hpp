@@ -3,11 +3,15 @@
 
 #include <cstdint>
 #include <atomic>
+#include <algorithm>
+#include <span>
 #include <cassert>
 #include <limits>
 #include <array>
 #include <iostream>
 #include "MemoryManagementPool.hpp"
+#include "Backoff.hpp"
+#include "ThreadHandle.hpp"
 
 namespace lcrq_queue {
 
@@ -37,8 +41,9 @@ namespace lcrq_queue {
     constexpr int NODE_POW = 10;
     constexpr std::size_t NODE_SIZE = 1ull << NODE_POW;
 
-    template<typename T>
-    class Queue {
+    template<typename T, template<typename> class Reclaimer = MemoryManagementPool,
+             typename Backoff = NoBackoff>
+    class Queue : public ThreadRegistration<Queue<T, Reclaimer, Backoff>> {
     private:
 
         struct alignas(128) Node { // Each addess is aligned to 128 bytes.
@@ -59,6 +64,8 @@ namespace lcrq_queue {
             alignas(128) std::atomic_intmax_t tail;
             alignas(128) std::atomic<CRQ*> next;
             std::array<Node, NODE_SIZE> ring;
+            uint64_t birthEra{0};
+            uint64_t id{0}; // Position in the list, set before linking
 
             CRQ() {
                 for (unsigned i = 0; i < NODE_SIZE; i++) {
@@ -74,11 +81,9 @@ namespace lcrq_queue {
         alignas(64) std::atomic<CRQ*> head;
         alignas(64) std::atomic<CRQ*> tail;
         std::size_t m_max_threads;
-        MemoryManagementPool<CRQ> mm;
-
-        bool isEmpty(T* v) {
-            return v == nullptr;
-        }
+        Reclaimer<CRQ> mm;
+        // Thread id, with the row of mm when it keeps one (see ThreadHandle.hpp)
+        using Thread = thread_ref_t<Reclaimer<CRQ>>;
 
         uint64_t getNodeIndex(uint64_t i) {
             return (i & ~(1ull << 63));
@@ -100,6 +105,24 @@ namespace lcrq_queue {
             return (t & (1ull << 63)) != 0;
         }
 
+        // Items of one ring, its tail may have passed NODE_SIZE
+        // tickets beyond its head
+        std::size_t ringSize(CRQ* rq) {
+            uint64_t t = tailIndex(rq->tail.load());
+            uint64_t h = rq->head.load();
+            return t > h ? std::min<uint64_t>(t - h, NODE_SIZE) : 0;
+        }
+
+        // Read-only empty check before taking a head ticket. head is
+        // read before tail, so when it finds every enqueue ticket
+        // already given to a dequeuer and no next ring, the queue was
+        // empty when tail was read. Polling an empty queue then does
+        // not write the ring (no fetch&add on head, no fixState).
+        bool isEmpty(CRQ* lhead) {
+            uint64_t h = lhead->head.load();
+            return h >= tailIndex(lhead->tail.load()) && lhead->next.load() == nullptr;
+        }
+
         void fixState(CRQ* lhead) {
             while(true) {
                 uint64_t tail_idx = lhead->tail.fetch_add(0);
@@ -124,6 +147,68 @@ namespace lcrq_queue {
             }
         }
 
+        // Enqueues elem in the cell of tailTkt. Returns false if the
+        // cell can not be used by this ticket.
+        bool enqueueTicket(CRQ* ltail, uint64_t tailTkt, T* elem) {
+            Node* cell = &ltail->ring[tailTkt & (NODE_SIZE - 1)];
+            uint64_t idx = cell->idx.load();
+            if (cell->val.load() == nullptr) {
+                if (getNodeIndex(idx) <= tailTkt) {
+                    if ((!getNodeUnsafe(idx) || (ltail->head.load() < (int64_t)tailTkt))) {
+                        if (CAS2((void**)cell, nullptr, idx, elem, tailTkt)) {
+                            return true;
+                        }
+                    }
+                }
+            }
+            return false;
+        }
+
+        // Dequeues the item of headTkt, or marks its cell so that the
+        // enqueuer of headTkt fails. Returns nullptr if there is no
+        // item for the ticket.
+        T* dequeueTicket(CRQ* lhead, uint64_t headTkt) {
+            Node* node = &lhead->ring[headTkt & (NODE_SIZE - 1)];
+            int r = 0;
+            uint64_t tt = 0;
+
+            while (true) {
+                uint64_t node_idx = node->idx.load();
+                uint64_t unsafe = getNodeUnsafe(node_idx);
+                uint64_t idx = getNodeIndex(node_idx);
+                T* val = node->val.load();
+
+                if (idx > headTkt) break;
+
+                if (val != nullptr) {
+                    if (idx == headTkt){
+                        if (CAS2((void**)node, val, node_idx, nullptr, unsafe | (headTkt+NODE_SIZE))) {
+                            return val;
+                        }
+                    } else {
+                        if (CAS2((void**)node, val, node_idx, val, setUnsafe(idx)))
+                            break;
+                    }
+                } else {
+                    if ((r & (NODE_SIZE - 1)) == 0) tt = lhead->tail.load();
+                    int crqClosed = crqIsClosed(tt);
+                    uint64_t t = tailIndex(tt);
+                    if (unsafe) {
+                        if (CAS2((void**)node, val, node_idx, val, unsafe | (headTkt + NODE_SIZE)))
+                            break;
+                    } else if (t < headTkt + 1 || r > 200000 || crqClosed) {
+                        if (CAS2((void**)node, val, idx, val, (headTkt + NODE_SIZE))) {
+                            if (r > 200000 && tt > NODE_SIZE) BIT_TEST_AND_SET(&lhead->tail, 63);
+                            break;
+                        }
+                    } else {
+                        ++r;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
     public:
         Queue(std::size_t max_threads = 64) : m_max_threads(max_threads) {
             CRQ* sentinel = new CRQ();
@@ -136,8 +221,25 @@ namespace lcrq_queue {
             delete head.load();
         };
 
-        void enqueue(T* elem, std::size_t thread_id) {
+        // Called by a thread that will not use the queue anymore
+        void release(std::size_t thread_id) {
+            mm.release(thread_id);
+        }
+
+        using ThreadRegistration<Queue>::enqueue;
+        using ThreadRegistration<Queue>::dequeue;
+        using ThreadRegistration<Queue>::approx_size;
+        using ThreadRegistration<Queue>::enqueue_bulk;
+        using ThreadRegistration<Queue>::dequeue_bulk;
+
+        // Called once by the handle of each thread
+        Thread thread_ref(const int thread_id) {
+            return ::thread_ref(mm, thread_id);
+        }
+
+        void enqueue(T* elem, Thread thread_id) {
             int try_close = 0;
+            static thread_local Backoff backoff;
             while (true) {
                 CRQ* ltail = mm.protectPointer(0, tail.load(), thread_id);
                 if (ltail != tail.load()) continue;
@@ -148,7 +250,8 @@ namespace lcrq_queue {
                 }
                 uint64_t tailTkt = ltail->tail.fetch_add(1);
                 if (crqIsClosed(tailTkt)) {
-                    CRQ* newNode = new CRQ();
+                    CRQ* newNode = mm.allocate(thread_id);
+                    newNode->id = ltail->id + 1;
                     newNode->tail.store(1, std::memory_order_relaxed);
                     newNode->ring[0].val.store(elem, std::memory_order_relaxed);
                     newNode->ring[0].idx.store(0, std::memory_order_relaxed);
@@ -156,74 +259,55 @@ namespace lcrq_queue {
                     if (ltail->next.compare_exchange_strong(nullNode, newNode)) {
                         tail.compare_exchange_strong(ltail, newNode);
                         mm.clear(thread_id);
+                        backoff.reset();
                         return;
                     }
                     delete newNode;
                     continue;
                 }
-                Node* cell = &ltail->ring[tailTkt & (NODE_SIZE - 1)];
-                uint64_t idx = cell->idx.load();
-                if (cell->val.load() == nullptr) {
-                    if (getNodeIndex(idx) <= tailTkt) {
-                        if ((!getNodeUnsafe(idx) || (ltail->head.load() < (int64_t)tailTkt))) {
-                            if (CAS2((void**)cell, nullptr, idx, elem, tailTkt)) {
-                                mm.clear(thread_id);
-                                return;
-                            }
-                        }
-                    }
+                if (enqueueTicket(ltail, tailTkt, elem)) {
+                    mm.clear(thread_id);
+                    backoff.reset();
+                    return;
                 }
                 if (((int64_t)(tailTkt - ltail->head.load()) >= (int64_t)NODE_SIZE)
                     && closeCRQ(ltail, tailTkt, ++try_close)) continue;
+                backoff();
             }
         };
 
-        T* dequeue(std::size_t thread_id) {
+        // Items of the rings, from their head and tail tickets,
+        // without writing shared state (only the hazard pointers of
+        // the caller). The rings between the first and the last one
+        // are counted as full, they are closed when full except under
+        // livelock (at most NODE_SIZE items more per such ring). The
+        // result is also off by the operations running concurrently,
+        // as the ends are read at different times.
+        std::size_t approx_size(Thread thread_id) {
+            CRQ* lhead = mm.protect(0, head, thread_id);
+            uint64_t first = lhead->id;
+            std::size_t size = ringSize(lhead);
+            CRQ* ltail = mm.protect(1, tail, thread_id);
+            if (ltail->id > first) {
+                size += ringSize(ltail) + (ltail->id - first - 1) * NODE_SIZE;
+            }
+            mm.clear(thread_id);
+            return size;
+        }
+
+        T* dequeue(Thread thread_id) {
             while (true) {
                 CRQ* lhead = mm.protectPointer(0, head.load(), thread_id);
                 if (lhead != head.load()) continue;
+                if (isEmpty(lhead)) {
+                    mm.clear(thread_id);
+                    return nullptr;
+                }
                 uint64_t headTkt = lhead->head.fetch_add(1);
-                Node* node = &lhead->ring[headTkt & (NODE_SIZE - 1)];
-
-                int r = 0;
-                uint64_t tt = 0;
-
-                while (true) {
-                    uint64_t node_idx = node->idx.load();
-                    uint64_t unsafe = getNodeUnsafe(node_idx);
-                    uint64_t idx = getNodeIndex(node_idx);
-                    T* val = node->val.load();
-
-                    if (idx > headTkt) break;
-
-                    if (val != nullptr) {
-                        if (idx == headTkt){
-                            if (CAS2((void**)node, val, node_idx, nullptr, unsafe | (headTkt+NODE_SIZE))) {
-                                mm.clear(thread_id);
-                                return val;
-                            }
-                        } else {
-                            if (CAS2((void**)node, val, node_idx, val, setUnsafe(idx)))
-                                break;
-                        }
-                    } else {
-                        if ((r & (NODE_SIZE - 1)) == 0) tt = lhead->tail.load();
-                        int crqClosed = crqIsClosed(tt);
-                        uint64_t t = tailIndex(tt);
-                        if (unsafe) {
-                            if (CAS2((void**)node, val, node_idx, val, unsafe | (headTkt + NODE_SIZE)))
-                                break;
-                        } else if (t < headTkt + 1 || r > 200000 || crqClosed) {
-                            if (CAS2((void**)node, val, idx, val, (headTkt + NODE_SIZE))) {
-                                if (r > 200000 && tt > NODE_SIZE) BIT_TEST_AND_SET(&lhead->tail, 63);
-                                break;
-                            }
-                        } else {
-                            ++r;
-                        }
-                    }
-
-
+                T* val = dequeueTicket(lhead, headTkt);
+                if (val != nullptr) {
+                    mm.clear(thread_id);
+                    return val;
                 }
                 if (tailIndex(lhead->tail.load()) <= headTkt + 1) {
                     fixState(lhead);
@@ -240,6 +324,90 @@ namespace lcrq_queue {
             }
         }
 
+        // Reserves a contiguous range of tickets with one fetch&add.
+        // When the cell of a ticket can not be used, the item is tried
+        // on the next ticket of the range, so every reserved ticket is
+        // either used or rejected by its cell (as in enqueue) and the
+        // dequeuers never wait on an abandoned one. The items left
+        // when the range is exhausted get a new range, so they keep
+        // their order.
+        void enqueue_bulk(std::span<T*> elems, Thread thread_id) {
+            int try_close = 0;
+            static thread_local Backoff backoff;
+            while (!elems.empty()) {
+                CRQ* ltail = mm.protectPointer(0, tail.load(), thread_id);
+                if (ltail != tail.load()) continue;
+                CRQ* lnext = ltail->next.load();
+                if (lnext != nullptr) {
+                    tail.compare_exchange_strong(ltail, lnext);
+                    continue;
+                }
+                uint64_t m = std::min<uint64_t>(elems.size(), NODE_SIZE);
+                uint64_t tailTkt = ltail->tail.fetch_add(m);
+                if (crqIsClosed(tailTkt)) {
+                    CRQ* newNode = mm.allocate(thread_id);
+                    newNode->id = ltail->id + 1;
+                    newNode->tail.store(m, std::memory_order_relaxed);
+                    for (uint64_t i = 0; i < m; i++) {
+                        newNode->ring[i].val.store(elems[i], std::memory_order_relaxed);
+                    }
+                    CRQ* nullNode = nullptr;
+                    if (ltail->next.compare_exchange_strong(nullNode, newNode)) {
+                        tail.compare_exchange_strong(ltail, newNode);
+                        elems = elems.subspan(m);
+                        continue;
+                    }
+                    delete newNode;
+                    continue;
+                }
+                uint64_t i = 0;
+                for (uint64_t j = 0; j < m; j++) {
+                    if (enqueueTicket(ltail, tailTkt + j, elems[i])) i++;
+                }
+                elems = elems.subspan(i);
+                if (i == m) continue;
+                uint64_t lastTkt = tailTkt + m - 1;
+                if (((int64_t)(lastTkt - ltail->head.load()) >= (int64_t)NODE_SIZE)
+                    && closeCRQ(ltail, lastTkt, ++try_close)) continue;
+                backoff();
+            }
+            mm.clear(thread_id);
+            backoff.reset();
+        }
+
+        // Reserves with one fetch&add as many head tickets as items
+        // seem available, up to max. Returns the number of items
+        // taken, 0 if the queue is empty.
+        std::size_t dequeue_bulk(std::span<T*> elems, std::size_t max, Thread thread_id) {
+            max = std::min(max, elems.size());
+            std::size_t taken = 0;
+            while (taken < max) {
+                CRQ* lhead = mm.protectPointer(0, head.load(), thread_id);
+                if (lhead != head.load()) continue;
+                if (isEmpty(lhead)) break;
+                int64_t available = (int64_t) tailIndex(lhead->tail.load()) - lhead->head.load();
+                uint64_t m = std::clamp<int64_t>(available, 1, max - taken);
+                uint64_t headTkt = lhead->head.fetch_add(m);
+                std::size_t before = taken;
+                for (uint64_t i = 0; i < m; i++) {
+                    T* val = dequeueTicket(lhead, headTkt + i);
+                    if (val != nullptr) elems[taken++] = val;
+                }
+                if (taken > before) continue;
+                uint64_t lastTkt = headTkt + m - 1;
+                if (tailIndex(lhead->tail.load()) <= lastTkt + 1) {
+                    fixState(lhead);
+                    CRQ* lnext = lhead->next.load();
+                    if (lnext == nullptr) break;
+                    if (tailIndex(lhead->tail) <= lastTkt + 1) {
+                        if (head.compare_exchange_strong(lhead, lnext)) mm.retire(lhead, thread_id);
+                    }
+                }
+            }
+            mm.clear(thread_id);
+            return taken;
+        }
+
         // Queue(const Queue&)                  = delete;
         // Queue(Queue&&)                       = delete;
         // const Queue& operator=(const Queue&) = delete;
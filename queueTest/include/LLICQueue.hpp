@@ -2,22 +2,46 @@
 #define _LL_IC_QUEUE_HPP
 
 #include <atomic>
+#include <cstdint>
 #include <limits>
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include "MemoryManagementPool.hpp"
+#include "NoReclamation.hpp"
+#include "Backoff.hpp"
+#include "Cells.hpp"
+#include "Roles.hpp"
+#include "ThreadHandle.hpp"
 
 namespace llic_queue {
 
     static constexpr int NODE_POW = 10;
-    static constexpr int ARRAY_POW = 16;
+    static constexpr int PAGE_POW = 10;
     static constexpr int ENQUEUERS = 64;
     static constexpr std::size_t NODE_SIZE = 1ull << NODE_POW;
-    static constexpr std::size_t ARRAY_SIZE = 1ull << ARRAY_POW;
+    static constexpr std::size_t PAGE_SIZE = 1ull << PAGE_POW;
+    // Entries of the directory of SegmentArray. Page p uses the entry
+    // p % DIRECTORY_SIZE, so at most 2^31 indices can be between
+    // HEAD and TAIL
+    static constexpr std::size_t DIRECTORY_SIZE = 1ull << (31 - NODE_POW - PAGE_POW);
+
+    // Indices returned by the LL/IC objects. They are 64-bit so a
+    // queue does not wrap around in any realistic run (2^64
+    // operations).
+    using Ticket = uint64_t;
 
     enum StateBasket {OPEN, CLOSED};
     enum StatePut {OK, FULL};
 
+    static constexpr int BASKET_CLOSED = -1;
+
     template<typename T>
     constexpr T* empty_ptr() {
         return reinterpret_cast<T*>(std::numeric_limits<uintmax_t>::max());
@@ -38,21 +62,70 @@ namespace llic_queue {
         return reinterpret_cast<T*>(std::numeric_limits<uintmax_t>::max() - 3);
     }
 
-    template<typename T, int K>
+    // Returned by forEnqueue of the bounded segment policies when the
+    // basket of the index can not be used yet
+    template<typename T>
+    constexpr T* full_ptr() {
+        return reinterpret_cast<T*>(std::numeric_limits<uintmax_t>::max() - 4);
+    }
+
+    // Cell selects what the items store (see Cells.hpp). The
+    // pointer sentinels above are the markers of PointerCell<T>.
+    template<typename T, int K, typename Cell = PointerCell<T>>
     class KBasketFAI {
+    public:
+        using value_type = typename Cell::value_type;
+        using cell_type = Cell;
      private:
         alignas(128) std::atomic<StateBasket> STATE{StateBasket::OPEN}; // 1 byte
         alignas(128) std::atomic<int> PUTS; // 8 bytes
         alignas(128) std::atomic<int> TAKES; // 8 bytes
-        std::atomic<T*> items[K]; // 8 * K bytes
+        std::atomic<value_type> items[K]; // sizeof(value_type) * K bytes
     public:
         KBasketFAI(): PUTS{0}, TAKES{0}  {
             for (unsigned i = 0; i < K; i++) {
-                items[i].store(bottom_ptr<T>());
+                items[i].store(bottom());
             }
         }
 
-        StatePut put(T* val) {
+        static std::string name() {
+            if constexpr (std::is_same_v<Cell, CompactCell>) {
+                return "FAI" + std::to_string(K) + "C";
+            } else {
+                return "FAI" + std::to_string(K);
+            }
+        }
+
+        static value_type top() {
+            return Cell::marker(1);
+        }
+
+        static value_type bottom() {
+            return Cell::marker(2);
+        }
+
+        // Returned by take when the basket is closed
+        static value_type closed() {
+            return Cell::marker(3);
+        }
+
+        // Reserves n slots of PUTS or TAKES. A side with a single
+        // thread (see Roles.hpp) owns its counter, a load and a store
+        // replace the fetch&add. The items are still exchanged, the
+        // other side may reach the same slot.
+        template<typename Role>
+        static int reserve(std::atomic<int>& counter, int n) {
+            if constexpr (Role::single) {
+                int c = counter.load(std::memory_order_relaxed);
+                counter.store(c + n, std::memory_order_relaxed);
+                return c;
+            } else {
+                return counter.fetch_add(n);
+            }
+        }
+
+        template<typename Role = MultiRole>
+        StatePut put(value_type val) {
             StateBasket state;
             int puts;
             while (true) {
@@ -62,122 +135,842 @@ namespace llic_queue {
                 if (state == StateBasket::CLOSED || puts >= K) {
                     return StatePut::FULL;
                 } else {
-                    puts = PUTS.fetch_add(1);
+                    puts = reserve<Role>(PUTS, 1);
                     if (puts >= K) {
                         return StatePut::FULL;
-                    } else if (items[puts].exchange(val) == bottom_ptr<T>()) {
+                    } else if (items[puts].exchange(val) == bottom()) {
                         return StatePut::OK;
                     }
                 }
             }
         }
 
-        T* take() {
+        template<typename Role = MultiRole>
+        value_type take() {
             int takes;
             while (true) {
                 takes = TAKES.load();
                 if (STATE.load() == StateBasket::CLOSED || takes >= K) {
-                    return basket_closed_ptr<T>();
+                    return closed();
                 } else {
-                    takes = TAKES.fetch_add(1);
+                    takes = reserve<Role>(TAKES, 1);
                     if (takes >= K) {
                         STATE.store(StateBasket::CLOSED);
-                        return basket_closed_ptr<T>();
+                        return closed();
                     } else {
-                        T* val = items[takes].exchange(top_ptr<T>());
-                        if (val != bottom_ptr<T>()) return val;
+                        value_type val = items[takes].exchange(top());
+                        if (val != bottom()) return val;
                     }
 
                 }
             }
         }
+
+        // Stores the longest prefix of vals that fits in the basket,
+        // reserving the slots with one fetch&add. Returns the number
+        // of items stored, 0 if the basket is full.
+        template<typename Role = MultiRole>
+        int put_bulk(std::span<value_type> vals) {
+            int puts;
+            while (true) {
+                puts = PUTS.load();
+                if (STATE.load() == StateBasket::CLOSED || puts >= K) {
+                    return 0;
+                }
+                int m = std::min((int) vals.size(), K - puts);
+                puts = reserve<Role>(PUTS, m);
+                if (puts >= K) {
+                    return 0;
+                }
+                int end = std::min(puts + m, K);
+                int stored = 0;
+                for (int i = puts; i < end; i++) {
+                    if (items[i].exchange(vals[stored]) != bottom()) break;
+                    stored++;
+                }
+                if (stored > 0) return stored;
+            }
+        }
+
+        // Takes up to vals.size() items, reserving the slots with one
+        // fetch&add. Returns the number of items taken or
+        // BASKET_CLOSED.
+        template<typename Role = MultiRole>
+        int take_bulk(std::span<value_type> vals) {
+            int takes;
+            while (true) {
+                takes = TAKES.load();
+                if (STATE.load() == StateBasket::CLOSED || takes >= K) {
+                    return BASKET_CLOSED;
+                }
+                int m = std::min((int) vals.size(), K - takes);
+                takes = reserve<Role>(TAKES, m);
+                if (takes >= K) {
+                    STATE.store(StateBasket::CLOSED);
+                    return BASKET_CLOSED;
+                }
+                int end = std::min(takes + m, K);
+                int taken = 0;
+                for (int i = takes; i < end; i++) {
+                    value_type val = items[i].exchange(top());
+                    if (val != bottom()) vals[taken++] = val;
+                }
+                if (taken > 0) return taken;
+            }
+        }
     };
 
-    class LLICCAS {
+    // LL/IC with a single CAS. A failed CAS means that other thread
+    // incremented R, the Backoff policy is applied before returning
+    // to the retry loop of the queue. The policy object is per thread
+    // (shared by the objects of the same type), so the adaptive
+    // policies learn from the previous operations.
+    template<typename Backoff>
+    class BackoffLLICCAS {
     private:
-        std::atomic<int> R;
+        std::atomic<Ticket> R;
     public:
-        LLICCAS() {
+        BackoffLLICCAS() {
             R.store(0, std::memory_order_relaxed);
         }
 
-        LLICCAS(std::size_t processes) {
+        BackoffLLICCAS(std::size_t processes) {
             (void) processes;
         }
 
-        int LL() {
+        static std::string name() {
+            if constexpr (std::is_same_v<Backoff, NoBackoff>) {
+                return "LLICCAS";
+            } else {
+                return "LLICCAS_" + Backoff::name();
+            }
+        }
+
+        Ticket LL() {
             return R.load();
         }
 
-        void IC(int expected) {
+        void IC(Ticket expected) {
+            static thread_local Backoff backoff;
             if (R.load() == expected) {
-                R.compare_exchange_strong(expected, expected + 1);
+                if (R.compare_exchange_strong(expected, expected + 1)) {
+                    backoff.reset();
+                } else {
+                    backoff();
+                }
             }
         }
 
-        void IC(int expected, std::size_t thread_id) {
+        void IC(Ticket expected, std::size_t thread_id) {
             (void) thread_id;
             this->IC(expected);
         }
     };
 
-    template<typename T, typename LLIC, typename Basket, std::size_t capacity>
-    class FAIQueue {
+    using LLICCAS = BackoffLLICCAS<NoBackoff>;
+
+    // LL/IC of an object incremented by a single thread: HEAD of a
+    // queue with one consumer, TAIL of a queue with one producer. The
+    // writer is the only one that can see R == expected change, so IC
+    // is a load and a release store, without CAS.
+    class SingleWriterLLIC {
     private:
-        Basket* A;
-        LLIC head{};
-        LLIC tail{};
+        std::atomic<Ticket> R;
     public:
-        FAIQueue() {
-            A = new Basket[capacity];
+        SingleWriterLLIC() {
+            R.store(0, std::memory_order_relaxed);
         }
 
-        FAIQueue(std::size_t cores) {
-            (void) cores;
-            A = new Basket[capacity];
+        SingleWriterLLIC(std::size_t processes) {
+            (void) processes;
         }
 
-        ~FAIQueue() {
-            delete[] A;
+        static std::string name() {
+            return "LLICSW";
         }
 
-        void enqueue(T* val, std::size_t thread_id) {
-            int tail;
+        Ticket LL() {
+            return R.load(std::memory_order_acquire);
+        }
+
+        void IC(Ticket expected) {
+            if (R.load(std::memory_order_relaxed) == expected) {
+                R.store(expected + 1, std::memory_order_release);
+            }
+        }
+
+        void IC(Ticket expected, std::size_t thread_id) {
+            (void) thread_id;
+            this->IC(expected);
+        }
+    };
+
+    // Segment policies. A segment policy maps the (unbounded) index
+    // returned by the LL/IC objects to a basket. Each policy exposes
+    // a nested Segments<Basket, Reclaimer> class with:
+    // - Basket* forEnqueue(Ticket index, thread_id): basket for the
+    //   index, allocating it if needed. nullptr if the index is stale,
+    //   full_ptr<Basket>() if the basket cannot be used until HEAD
+    //   advances (the queue is full).
+    // - Basket* forDequeue(Ticket index, thread_id): basket for the
+    //   index. nullptr if the basket has been already reclaimed.
+    // - void advance(Ticket head, thread_id): HEAD has reached head, the
+    //   baskets below it can be reclaimed.
+    // - void release(thread_id): drops the protection of the thread.
+
+    // A single array of capacity baskets, allocated at construction.
+    // It serves capacity enqueues in total, SegmentRing reuses them.
+    // Once TAIL reaches capacity the enqueues return FULL.
+    template<std::size_t capacity>
+    struct FixedArray {
+        static std::string name() {
+            return "FIXED";
+        }
+
+        template<typename Basket, template<typename> class Reclaimer>
+        class Segments {
+        private:
+            Basket* A;
+        public:
+            Segments(std::size_t max_threads = 64) {
+                (void) max_threads;
+                A = new Basket[capacity];
+            }
+
+            ~Segments() {
+                delete[] A;
+            }
+
+            Basket* forEnqueue(Ticket index, std::size_t thread_id) {
+                (void) thread_id;
+                if (index >= capacity) return full_ptr<Basket>();
+                return &A[index];
+            }
+
+            Basket* forDequeue(Ticket index, std::size_t thread_id) {
+                (void) thread_id;
+                if (index >= capacity) return nullptr;
+                return &A[index];
+            }
+
+            void advance(Ticket head, std::size_t thread_id) {
+                (void) head;
+                (void) thread_id;
+            }
+
+            void release(std::size_t thread_id) {
+                (void) thread_id;
+            }
+        };
+    };
+
+    // A ring of capacity / NODE_SIZE segments of NODE_SIZE baskets
+    // for queues that run indefinitely. The index i is in segment
+    // s = i / NODE_SIZE, stored in the slot s % RING. Once HEAD has
+    // passed a segment it is retired and its slot is emptied; the
+    // reclaimer recycles the node (resetting its baskets) for a later
+    // segment. Memory stays bounded by the RING segments plus the
+    // objects held by the reclaimer.
+
+    // When the slot of an enqueuer still holds the segment of the
+    // previous lap, the queue holds about capacity items and the
+    // enqueue returns FULL, without waiting for the dequeuers.
+    template<std::size_t capacity>
+    struct SegmentRing {
+        static constexpr std::size_t RING = std::max<std::size_t>(2, (capacity + NODE_SIZE - 1) / NODE_SIZE);
+
+        static std::string name() {
+            return "RING";
+        }
+
+        template<typename Basket, template<typename> class Reclaimer>
+        class Segments {
+        private:
+            struct Node {
+                std::array<Basket, NODE_SIZE> ring;
+                const Ticket id;
+                uint64_t birthEra{0};
+
+                Node(Ticket id) : id(id) {}
+            };
+
+            std::array<std::atomic<Node*>, RING> slots;
+            // Segments below firstId have been passed by HEAD
+            alignas(64) std::atomic<Ticket> firstId{0};
+            Reclaimer<Node> mm;
+            using Thread = thread_ref_t<Reclaimer<Node>>;
+
+        public:
+            Segments(std::size_t max_threads = 64) {
+                (void) max_threads;
+                for (unsigned i = 0; i < RING; i++) {
+                    slots[i].store(nullptr, std::memory_order_relaxed);
+                }
+            }
+
+            ~Segments() {
+                for (unsigned i = 0; i < RING; i++) {
+                    delete slots[i].load();
+                }
+            }
+
+            // Called once by the handle of a thread, see ThreadHandle.hpp
+            Thread thread_ref(const int thread_id) {
+                return ::thread_ref(mm, thread_id);
+            }
+
+            Basket* forEnqueue(Ticket index, Thread thread_id) {
+                Ticket id = index / NODE_SIZE;
+                auto& slot = slots[id % RING];
+                while (true) {
+                    Node* node = mm.protect(0, slot, thread_id);
+                    if (node == nullptr) {
+                        if (id < firstId.load()) return nullptr;
+                        Node* newNode = mm.protectPointer(0, mm.allocate(thread_id, id), thread_id);
+                        if (!slot.compare_exchange_strong(node, newNode)) {
+                            delete newNode;
+                            continue;
+                        }
+                        // HEAD passed the segment before it was installed
+                        if (id < firstId.load()) {
+                            if (slot.compare_exchange_strong(newNode, nullptr)) {
+                                mm.retire(newNode, thread_id);
+                            }
+                            return nullptr;
+                        }
+                        node = newNode;
+                    }
+                    if (node->id == id) return &node->ring[index % NODE_SIZE];
+                    if (node->id > id) return nullptr;
+                    // The previous lap is still live
+                    return full_ptr<Basket>();
+                }
+            }
+
+            Basket* forDequeue(Ticket index, Thread thread_id) {
+                Ticket id = index / NODE_SIZE;
+                Node* node = mm.protect(0, slots[id % RING], thread_id);
+                if (node == nullptr || node->id != id) return nullptr;
+                return &node->ring[index % NODE_SIZE];
+            }
+
+            // firstId moves before the slot is emptied, so an enqueuer
+            // that finds the slot empty also sees the segment as passed
+            void advance(Ticket head, Thread thread_id) {
+                if (head % NODE_SIZE != 0) return;
+                Ticket id = head / NODE_SIZE - 1;
+                Ticket currId = firstId.load();
+                while (currId <= id && !firstId.compare_exchange_weak(currId, id + 1));
+                auto& slot = slots[id % RING];
+                Node* node = mm.protect(0, slot, thread_id);
+                if (node != nullptr && node->id == id && slot.compare_exchange_strong(node, nullptr)) {
+                    mm.retire(node, thread_id);
+                }
+            }
+
+            void release(Thread thread_id) {
+                mm.clear(thread_id);
+            }
+        };
+    };
+
+    // A two-level directory: DIRECTORY_SIZE pointers to pages of
+    // PAGE_SIZE pointers to segments of NODE_SIZE baskets. The index
+    // i is in segment i / NODE_SIZE, at position i % NODE_SIZE, and
+    // the segment is in page i / (NODE_SIZE * PAGE_SIZE). Pages and
+    // segments are allocated on demand and retired once HEAD has
+    // passed all their baskets, so the memory follows the live window
+    // of the queue (plus the DIRECTORY_SIZE pointers). Page p takes
+    // the entry p % DIRECTORY_SIZE once page p - DIRECTORY_SIZE has
+    // been retired, the enqueues return FULL until then.
+    struct SegmentArray {
+        static std::string name() {
+            return "ARRAY";
+        }
+
+        template<typename Basket, template<typename> class Reclaimer>
+        class Segments {
+        private:
+            struct Node {
+                std::array<Basket, NODE_SIZE> ring;
+                uint64_t birthEra{0};
+            };
+
+            struct Page {
+                std::array<std::atomic<Node*>, PAGE_SIZE> slots{};
+                std::atomic<std::size_t> retiredSlots{0};
+                const std::size_t number;
+                uint64_t birthEra{0};
+
+                Page(std::size_t number) : number(number) {}
+            };
+
+            std::array<std::atomic<Page*>, DIRECTORY_SIZE> directory;
+            Reclaimer<Node> mm;
+            Reclaimer<Page> pages_mm;
+            using Thread = thread_ref_t<Reclaimer<Node>>;
+
+            template<typename P>
+            static P* retired() {
+                return reinterpret_cast<P*>(std::numeric_limits<uintmax_t>::max());
+            }
+
+            // A retired page leaves its number in the entry, with
+            // the top bit set (page numbers are below 2^44)
+            static constexpr uintptr_t RETIRED_PAGE = uintptr_t(1) << 63;
+
+            static Page* retiredPage(std::size_t number) {
+                return reinterpret_cast<Page*>(RETIRED_PAGE | number);
+            }
+
+            static bool isRetired(Page* page) {
+                return (reinterpret_cast<uintptr_t>(page) & RETIRED_PAGE) != 0;
+            }
+
+            // Number of the page in an entry, live or retired
+            static std::size_t numberOf(Page* page) {
+                if (isRetired(page)) return reinterpret_cast<uintptr_t>(page) & ~RETIRED_PAGE;
+                return page->number;
+            }
+
+            // What the entry of the page holds just before the page
+            // is created
+            static Page* previousOf(std::size_t number) {
+                if (number < DIRECTORY_SIZE) return nullptr;
+                return retiredPage(number - DIRECTORY_SIZE);
+            }
+
+            static std::size_t segmentOf(Ticket index) {
+                return index / NODE_SIZE;
+            }
+
+            // Protected page of the segment, nullptr if it has been
+            // retired (or does not exist and create is false).
+            // full_ptr<Page>() if create is true and the entry still
+            // belongs to an older page. pages_mm keeps its own rows, it
+            // gets the plain id and not the Thread of mm.
+            Page* pageOf(std::size_t segment, bool create, int thread_id) {
+                std::size_t number = segment / PAGE_SIZE;
+                auto& entry = directory[number % DIRECTORY_SIZE];
+                while (true) {
+                    Page* page = pages_mm.protect(0, entry, thread_id);
+                    if (page != nullptr && !isRetired(page) && page->number == number) return page;
+                    if (page == previousOf(number) && create) {
+                        Page* newPage = pages_mm.allocate(thread_id, number);
+                        if (!entry.compare_exchange_strong(page, newPage)) {
+                            delete newPage;
+                        }
+                        continue;
+                    }
+                    if (page != nullptr && numberOf(page) >= number) return nullptr;
+                    return create ? full_ptr<Page>() : nullptr;
+                }
+            }
+
+        public:
+            Segments(std::size_t max_threads = 64) {
+                (void) max_threads;
+                for (unsigned i = 0; i < DIRECTORY_SIZE; i++) {
+                    directory[i].store(nullptr, std::memory_order_relaxed);
+                }
+            }
+
+            ~Segments() {
+                for (unsigned i = 0; i < DIRECTORY_SIZE; i++) {
+                    Page* page = directory[i].load();
+                    if (page == nullptr || isRetired(page)) continue;
+                    for (auto& slot : page->slots) {
+                        Node* node = slot.load();
+                        if (node != nullptr && node != retired<Node>()) delete node;
+                    }
+                    delete page;
+                }
+            }
+
+            // Called once by the handle of a thread, see ThreadHandle.hpp
+            Thread thread_ref(const int thread_id) {
+                return ::thread_ref(mm, thread_id);
+            }
+
+            Basket* forEnqueue(Ticket index, Thread thread_id) {
+                std::size_t segment = segmentOf(index);
+                Page* page = pageOf(segment, true, thread_id);
+                if (page == full_ptr<Page>()) return full_ptr<Basket>();
+                if (page == nullptr) return nullptr;
+                auto& slot = page->slots[segment % PAGE_SIZE];
+                Node* node = mm.protect(0, slot, thread_id);
+                if (node == nullptr) {
+                    Node* newNode = mm.allocate(thread_id);
+                    if (!slot.compare_exchange_strong(node, newNode)) {
+                        delete newNode;
+                    }
+                    node = mm.protect(0, slot, thread_id);
+                }
+                if (node == retired<Node>()) return nullptr;
+                return &node->ring[index % NODE_SIZE];
+            }
+
+            Basket* forDequeue(Ticket index, Thread thread_id) {
+                std::size_t segment = segmentOf(index);
+                Page* page = pageOf(segment, false, thread_id);
+                if (page == nullptr) return nullptr;
+                Node* node = mm.protect(0, page->slots[segment % PAGE_SIZE], thread_id);
+                if (node == nullptr || node == retired<Node>()) return nullptr;
+                return &node->ring[index % NODE_SIZE];
+            }
+
+            // Several threads may see the same head, the exchange
+            // makes only one of them retire the segment. The segments
+            // of a page may be advanced out of order (a thread can
+            // stop between IC and advance), so the page is retired by
+            // the thread that retires its last slot, not by the one
+            // that advances its last segment.
+            void advance(Ticket head, Thread thread_id) {
+                if (head % NODE_SIZE != 0) return;
+                std::size_t segment = segmentOf(head) - 1;
+                Page* page = pageOf(segment, false, thread_id);
+                if (page == nullptr) return;
+                Node* node = page->slots[segment % PAGE_SIZE].exchange(retired<Node>());
+                if (node == retired<Node>()) return;
+                if (node != nullptr) {
+                    mm.retire(node, thread_id);
+                }
+                if (page->retiredSlots.fetch_add(1) + 1 != PAGE_SIZE) return;
+                std::size_t number = page->number;
+                if (directory[number % DIRECTORY_SIZE].compare_exchange_strong(page, retiredPage(number))) {
+                    pages_mm.retire(page, (int) thread_id);
+                }
+            }
+
+            void release(Thread thread_id) {
+                mm.clear(thread_id);
+                pages_mm.clear((int) thread_id);
+            }
+        };
+    };
+
+    // A linked list of segments of NODE_SIZE baskets. The LL/IC
+    // objects stay global, the index selects the segment id and the
+    // position inside of it. first is the oldest live segment and
+    // last is a hint to the newest one, it is never behind first.
+    struct LinkedSegments {
+        static std::string name() {
+            return "LINKED";
+        }
+
+        template<typename Basket, template<typename> class Reclaimer>
+        class Segments {
+        private:
+            struct Node {
+                std::array<Basket, NODE_SIZE> ring;
+                std::atomic<Node*> next{nullptr};
+                const Ticket id;
+                uint64_t birthEra{0};
+
+                Node(Ticket id) : id(id) {}
+            };
+
+            alignas(64) std::atomic<Node*> first;
+            alignas(64) std::atomic<Node*> last;
+            alignas(64) std::atomic<Ticket> firstId{0};
+            Reclaimer<Node> mm;
+            using Thread = thread_ref_t<Reclaimer<Node>>;
+
+            Node* nextOf(Node* node, Thread thread_id) {
+                Node* next = node->next.load();
+                if (next == nullptr) {
+                    Node* newNode = mm.allocate(thread_id, node->id + 1);
+                    if (node->next.compare_exchange_strong(next, newNode)) {
+                        return newNode;
+                    }
+                    delete newNode;
+                }
+                return next;
+            }
+
+            // Walks from start up to the segment with the given id,
+            // using two hazard pointers hand over hand. A segment is
+            // retired only after firstId has passed it, so checking
+            // firstId after publishing the hazard validates it. When
+            // the walk starts at last, last is moved to the segment.
+            Node* find(std::atomic<Node*>& start, Ticket id, Thread thread_id) {
+                while (true) {
+                    if (id < firstId.load()) return nullptr;
+                    Node* origin = mm.protect(2, start, thread_id);
+                    if (origin->id > id) {
+                        if (&start == &first) return nullptr;
+                        return find(first, id, thread_id);
+                    }
+                    Node* curr = origin;
+                    int hp = 0;
+                    bool valid = true;
+                    while (curr->id < id) {
+                        Node* next = nextOf(curr, thread_id);
+                        mm.protectPointer(hp, next, thread_id);
+                        hp = 1 - hp;
+                        if (firstId.load() > curr->id + 1) {
+                            valid = false;
+                            break;
+                        }
+                        curr = next;
+                    }
+                    if (!valid) continue;
+                    if (&start == &last && curr != origin) {
+                        last.compare_exchange_strong(origin, curr);
+                    }
+                    return curr;
+                }
+            }
+
+        public:
+            Segments(std::size_t max_threads = 64) {
+                (void) max_threads;
+                Node* sentinel = new Node(0);
+                first.store(sentinel, std::memory_order_relaxed);
+                last.store(sentinel, std::memory_order_relaxed);
+            }
+
+            ~Segments() {
+                Node* node = first.load();
+                while (node != nullptr) {
+                    Node* next = node->next.load();
+                    delete node;
+                    node = next;
+                }
+            }
+
+            // Called once by the handle of a thread, see ThreadHandle.hpp
+            Thread thread_ref(const int thread_id) {
+                return ::thread_ref(mm, thread_id);
+            }
+
+            Basket* forEnqueue(Ticket index, Thread thread_id) {
+                Node* node = find(last, index / NODE_SIZE, thread_id);
+                if (node == nullptr) return nullptr;
+                return &node->ring[index % NODE_SIZE];
+            }
+
+            Basket* forDequeue(Ticket index, Thread thread_id) {
+                Node* node = find(first, index / NODE_SIZE, thread_id);
+                if (node == nullptr) return nullptr;
+                return &node->ring[index % NODE_SIZE];
+            }
+
+            void advance(Ticket head, Thread thread_id) {
+                if (head % NODE_SIZE != 0) return;
+                Ticket id = head / NODE_SIZE;
+                while (true) {
+                    Node* node = mm.protect(3, first, thread_id);
+                    Ticket nextId = node->id + 1;
+                    if (nextId > id) return;
+                    Node* next = nextOf(node, thread_id);
+                    // last must leave the segment before it is retired
+                    Node* expected = node;
+                    last.compare_exchange_strong(expected, next);
+                    if (first.compare_exchange_strong(node, next)) {
+                        Ticket currId = firstId.load();
+                        while (currId < nextId && !firstId.compare_exchange_weak(currId, nextId));
+                        mm.retire(node, thread_id);
+                    }
+                }
+            }
+
+            void release(Thread thread_id) {
+                mm.clear(thread_id);
+            }
+        };
+    };
+
+    // Basket queue composed from an LL/IC object for the HEAD and
+    // TAIL indices, a basket type, a segment policy and a memory
+    // reclaimer for the segments. The values are the ones of the
+    // basket (T*, or 32-bit values with a CompactCell basket).
+    // Producer and Consumer give the number of threads of each side
+    // (see Roles.hpp). A Single side increments its index with a
+    // SingleWriterLLIC and reserves the slots of the baskets without
+    // fetch&add.
+    template<typename T, typename LLIC, typename Basket, typename SegmentPolicy,
+             template<typename> class Reclaimer = MemoryManagementPool,
+             typename Producer = ProducerPolicy::Multi, typename Consumer = ConsumerPolicy::Multi>
+    class BasketQueue : public ThreadRegistration<BasketQueue<T, LLIC, Basket, SegmentPolicy, Reclaimer, Producer, Consumer>> {
+    private:
+        using Segments = typename SegmentPolicy::template Segments<Basket, Reclaimer>;
+        using Thread = thread_ref_t<Segments>;
+        using Value = typename Basket::value_type;
+        using Cell = typename Basket::cell_type;
+        using HeadLLIC = std::conditional_t<Consumer::single, SingleWriterLLIC, LLIC>;
+        using TailLLIC = std::conditional_t<Producer::single, SingleWriterLLIC, LLIC>;
+
+        Segments segments;
+        HeadLLIC head{};
+        TailLLIC tail{};
+    public:
+        BasketQueue(std::size_t max_threads = 64) : segments{max_threads} {}
+
+        static std::string name() {
+            std::string roles;
+            if constexpr (Producer::single || Consumer::single) {
+                roles = "_" + Producer::name() + "P" + Consumer::name() + "C";
+            }
+            return LLIC::name() + "_" + Basket::name() + "_" + SegmentPolicy::name()
+                + "_" + Reclaimer<Basket>::name() + roles;
+        }
+
+        using ThreadRegistration<BasketQueue>::enqueue;
+        using ThreadRegistration<BasketQueue>::dequeue;
+        using ThreadRegistration<BasketQueue>::approx_size;
+        using ThreadRegistration<BasketQueue>::enqueue_bulk;
+        using ThreadRegistration<BasketQueue>::dequeue_bulk;
+
+        // Called once by the handle of a thread, see ThreadHandle.hpp
+        Thread thread_ref(const int thread_id) {
+            return ::thread_ref(segments, thread_id);
+        }
+
+        // FULL when a bounded segment policy (SegmentRing) has no
+        // basket for TAIL yet, or when SegmentArray holds 2^31 indices
+        // between HEAD and TAIL. The item is not enqueued. Always OK
+        // with LinkedSegments.
+        StatePut enqueue(Value val, Thread thread_id) {
+            Ticket tail;
             while (true) {
                 tail = this->tail.LL();
-                if (A[tail].put(val) == StatePut::OK) {
+                Basket* basket = segments.forEnqueue(tail, thread_id);
+                if (basket == full_ptr<Basket>()) {
+                    segments.release(thread_id);
+                    return StatePut::FULL;
+                }
+                if (basket != nullptr && basket->template put<Producer>(val) == StatePut::OK) {
                     this->tail.IC(tail, thread_id);
-                    return;
+                    segments.release(thread_id);
+                    return StatePut::OK;
                 }
                 this->tail.IC(tail, thread_id);
             }
         }
 
-        T* dequeue(std::size_t thread_id) {
-            int head = this->head.LL();
-            int tail = this->tail.LL();
-            T* val = nullptr;
+        // HEAD never passes TAIL and HEAD is read first, so HEAD >=
+        // TAIL means that the queue was empty when TAIL was read. This
+        // first check returns without touching the segments.
+        Value dequeue(Thread thread_id) {
+            Ticket head = this->head.LL();
+            Ticket tail = this->tail.LL();
+            if (head >= tail) return Cell::null();
+            Value val = Cell::null();
             while (true) {
                 if (head < tail) {
-                    val = A[head].take();
-                    if (val != basket_closed_ptr<T>()) {
+                    Basket* basket = segments.forDequeue(head, thread_id);
+                    val = basket == nullptr ? Basket::closed() : basket->template take<Consumer>();
+                    if (val != Basket::closed()) {
+                        segments.release(thread_id);
                         return val;
                     }
                     this->head.IC(head, thread_id);
+                    segments.advance(head + 1, thread_id);
                 }
                 auto hhead = this->head.LL();
                 auto ttail = this->tail.LL();
                 if (hhead == head && ttail == tail) {
-                    return nullptr;
+                    segments.release(thread_id);
+                    return Cell::null();
                 }
                 head = hhead;
                 tail = ttail;
             }
         }
+
+        // Baskets between HEAD and TAIL, two loads and no write. A
+        // basket below TAIL holds between 0 and K items (one per
+        // enqueue without contention), so the size is at most K times
+        // this value, plus the operations running concurrently.
+        std::size_t approx_size(std::size_t thread_id) {
+            (void) thread_id;
+            Ticket h = this->head.LL();
+            Ticket t = this->tail.LL();
+            return t > h ? t - h : 0;
+        }
+
+        // Bulk versions, each basket receives (or gives) as many items
+        // as it can with a single fetch&add. The basket type must
+        // provide put_bulk and take_bulk. enqueue_bulk returns the
+        // number of items enqueued, less than vals.size() only when the
+        // queue is FULL.
+        std::size_t enqueue_bulk(std::span<Value> vals, Thread thread_id) {
+            std::size_t total = vals.size();
+            Ticket tail;
+            while (!vals.empty()) {
+                tail = this->tail.LL();
+                Basket* basket = segments.forEnqueue(tail, thread_id);
+                if (basket == full_ptr<Basket>()) break;
+                if (basket != nullptr) {
+                    vals = vals.subspan(basket->template put_bulk<Producer>(vals));
+                }
+                this->tail.IC(tail, thread_id);
+            }
+            segments.release(thread_id);
+            return total - vals.size();
+        }
+
+        std::size_t dequeue_bulk(std::span<Value> vals, std::size_t max, Thread thread_id) {
+            vals = vals.first(std::min(vals.size(), max));
+            std::size_t taken = 0;
+            Ticket head = this->head.LL();
+            Ticket tail = this->tail.LL();
+            if (head >= tail) return 0;
+            while (taken < vals.size()) {
+                if (head < tail) {
+                    Basket* basket = segments.forDequeue(head, thread_id);
+                    int n = basket == nullptr ? BASKET_CLOSED : basket->template take_bulk<Consumer>(vals.subspan(taken));
+                    if (n != BASKET_CLOSED) {
+                        taken += n;
+                        continue;
+                    }
+                    this->head.IC(head, thread_id);
+                    segments.advance(head + 1, thread_id);
+                }
+                auto hhead = this->head.LL();
+                auto ttail = this->tail.LL();
+                if (hhead == head && ttail == tail) {
+                    break;
+                }
+                head = hhead;
+                tail = ttail;
+            }
+            segments.release(thread_id);
+            return taken;
+        }
     };
 
+    // capacity bounds the items in the queue, not the operations
+    template<typename T, typename LLIC, typename Basket, std::size_t capacity>
+    using FAIQueue = BasketQueue<T, LLIC, Basket, SegmentRing<capacity>, MemoryManagementPool>;
+
+    // Many producers and one consumer, and the reverse
+    template<typename T, typename LLIC, typename Basket, std::size_t capacity>
+    using FAIQueueMPSC = BasketQueue<T, LLIC, Basket, SegmentRing<capacity>, MemoryManagementPool,
+                                     ProducerPolicy::Multi, ConsumerPolicy::Single>;
+
+    template<typename T, typename LLIC, typename Basket, std::size_t capacity>
+    using FAIQueueSPMC = BasketQueue<T, LLIC, Basket, SegmentRing<capacity>, MemoryManagementPool,
+                                     ProducerPolicy::Single, ConsumerPolicy::Multi>;
+
+    template<typename LLIC, int K, std::size_t capacity>
+    using CompactFAIQueue = FAIQueue<uint32_t, LLIC, KBasketFAI<uint32_t, K, CompactCell>, capacity>;
+
+    template<typename T, typename LLIC, typename Basket>
+    using FAIQueueArray = BasketQueue<T, LLIC, Basket, SegmentArray, MemoryManagementPool>;
+
+    // Same directory, but drained segments are only freed with the
+    // queue. It replaces the version that embedded every segment in
+    // the queue object.
+    template<typename T, typename LLIC, typename Basket>
+    using FAIQueueArray2 = BasketQueue<T, LLIC, Basket, SegmentArray, NoReclamation>;
+
+    template<typename T, typename LLIC, typename Basket>
+    using FAIQueueLinked = BasketQueue<T, LLIC, Basket, LinkedSegments, MemoryManagementPool>;
+
     template<typename T, typename LLIC, typename Basket, int CAPACITY>
-    class FAIQueueHP {
+    class FAIQueueHP : public ThreadRegistration<FAIQueueHP<T, LLIC, Basket, CAPACITY>> {
     private:
         std::size_t capacity;
         std::size_t size_k;
@@ -216,10 +1009,14 @@ namespace llic_queue {
             while(dequeue(0) != nullptr);
         }
 
+        using ThreadRegistration<FAIQueueHP>::enqueue;
+        using ThreadRegistration<FAIQueueHP>::dequeue;
+        using ThreadRegistration<FAIQueueHP>::approx_size;
+
         void enqueue(T* elem, std::size_t thread_id) {
             while (true) {
                 int n = (nodes.load() - 1) % CAPACITY;
-                int tail = this->tail.LL();
+                Ticket tail = this->tail.LL();
                 int t = tail % NODE_SIZE;
                 // mark array[n] as hazardous
                 if(array[n].load()->ring[t].put(elem) == StatePut::OK) {
@@ -241,9 +1038,17 @@ namespace llic_queue {
             }
         }
 
+        // Baskets between HEAD and TAIL, see BasketQueue
+        std::size_t approx_size(std::size_t thread_id) {
+            (void) thread_id;
+            Ticket h = this->head.LL();
+            Ticket t = this->tail.LL();
+            return t > h ? t - h : 0;
+        }
+
         T* dequeue(std::size_t thread_id) {
-            int head = this->head.LL();
-            int tail = this->tail.LL();
+            Ticket head = this->head.LL();
+            Ticket tail = this->tail.LL();
             int h = head % NODE_SIZE;
             int n = (this->nodes.load() - 1);
             T* val = nullptr;
@@ -266,174 +1071,17 @@ namespace llic_queue {
         }
     };
 
-    template <typename T, typename LLIC, typename Basket>
-    class FAIQueueArray {
-        // This queue must simulate an infinite array-based queue, but
-        // using nodes, where each contains an array of baskets
-        // We must remember that the baskets only store items whose
-        // insertions were concurrent.
-    private:
-        struct Node {
-            std::array<Basket, NODE_SIZE> ring;
-        };
-        LLIC Head; // Actual head index
-        LLIC Tail;
-        // We need an array of pointers to segments
-        std::array<std::atomic<Node*>, ARRAY_SIZE> array;
-        // std::atomic<Node*> array[NODE_SIZE]; // Without parameterize the class, we can store a maximum of 2^20 items, approx 1 million of items
-        MemoryManagementPool<Node> mm;
-
-    public:
-        FAIQueueArray() {
-            for (unsigned i = 0; i < ARRAY_SIZE; i++) {
-                array[i].store(nullptr, std::memory_order_relaxed);
-            }
-        }
-
-        FAIQueueArray(std::size_t cores) {
-            (void) cores;
-            for (unsigned i = 0; i < ARRAY_SIZE; i++) {
-                array[i].store(nullptr, std::memory_order_relaxed);
-            }
-        };
-
-        ~FAIQueueArray() {
-            for (unsigned i = 0; i < ARRAY_SIZE; i++) {
-                if (array[i] != nullptr) delete array[i];
-            }
-        }
-
-        void enqueue(T* val, std::size_t thread_id) {
-            int tail, node, pos;
-            while (true) {
-                tail = this->Tail.LL();
-                node = tail / ARRAY_SIZE;
-                pos = tail % NODE_SIZE;
-                if (array[node] == nullptr) {
-                    Node* newNode = new Node();
-                    newNode->ring[0].put(val);
-                    Node* nullNode = nullptr;
-                    if (array[node].compare_exchange_strong(nullNode, newNode)) {
-                        this->Tail.IC(tail, thread_id);
-                        return;
-                    }
-                    delete newNode;
-                    this->Tail.IC(tail, thread_id);
-                    continue;
-                } else if (array[node].load()->ring[pos].put(val) == StatePut::OK) {
-                    this->Tail.IC(tail, thread_id);
-                    return;
-                }
-                this->Tail.IC(tail, thread_id);
-            }
-        }
-
-        T* dequeue(std::size_t thread_id) {
-            int head = this->Head.LL();
-            int tail = this->Tail.LL();
-            int node, pos;
-            T* val = nullptr;
-
-            while (true) {
-                if (head < tail) {
-                    node = head / ARRAY_SIZE;
-                    pos = head % NODE_SIZE;
-                    val = array[node].load()->ring[pos].take();
-                    if (val != basket_closed_ptr<T>()) {
-                        return val;
-                    }
-                    this->Head.IC(head, thread_id);
-                }
-                auto hhead = this->Head.LL();
-                auto ttail = this->Tail.LL();
-                if (hhead == head && ttail == tail && head == tail) return nullptr;
-                head = hhead;
-                tail = ttail;
-            }
-            return val;
-        }
-
-    };
-
-
-    template <typename T, typename LLIC, typename Basket>
-    class FAIQueueArray2 {
-        // This queue must simulate an infinite array-based queue, but
-        // using nodes, where each contains an array of baskets
-        // We must remember that the baskets only store items whose
-        // insertions were concurrent.
-    private:
-        struct Node {
-            std::array<Basket, NODE_SIZE> ring;
-        };
-        LLIC Head; // Actual head index
-        LLIC Tail;
-        // We need an array of pointers to segments
-        std::array<Node, ARRAY_SIZE> array;
-        // std::atomic<Node*> array[NODE_SIZE]; // Without parameterize the class, we can store a maximum of 2^20 items, approx 1 million of items
-        MemoryManagementPool<Node> mm;
-
-    public:
-        FAIQueueArray2() {
-        }
-
-        FAIQueueArray2(std::size_t cores) {
-            (void) cores;
-        };
-
-        ~FAIQueueArray2() {
-        }
-
-        void enqueue(T* val, std::size_t thread_id) {
-            int tail, node, pos;
-            while (true) {
-                tail = this->Tail.LL();
-                node = tail / ARRAY_SIZE;
-                pos = tail % NODE_SIZE;
-                if (array[node].ring[pos].put(val) == StatePut::OK) {
-                    this->Tail.IC(tail, thread_id);
-                    return;
-                }
-                this->Tail.IC(tail, thread_id);
-            }
-        }
-
-        T* dequeue(std::size_t thread_id) {
-            int head = this->Head.LL();
-            int tail = this->Tail.LL();
-            int node, pos;
-            T* val = nullptr;
-
-            while (true) {
-                if (head < tail) {
-                    node = head / ARRAY_SIZE;
-                    pos = head % NODE_SIZE;
-                    val = array[node].ring[pos].take();
-                    if (val != basket_closed_ptr<T>()) {
-                        return val;
-                    }
-                    this->Head.IC(head, thread_id);
-                }
-                auto hhead = this->Head.LL();
-                auto ttail = this->Tail.LL();
-                if (hhead == head && ttail == tail && head == tail) return nullptr;
-                head = hhead;
-                tail = ttail;
-            }
-            return val;
-        }
-
-    };
-
-
-    template<typename T, typename LLIC, typename Basket>
-    class Queue {
+    template<typename T, typename LLIC, typename Basket,
+             template<typename> class Reclaimer = MemoryManagementPool>
+    class Queue : public ThreadRegistration<Queue<T, LLIC, Basket, Reclaimer>> {
 
         struct Segment {
             Basket* items;
             LLIC HEAD;
             LLIC TAIL;
             std::atomic<Segment*> next;
+            uint64_t birthEra{0};
+            uint64_t id{0}; // Position in the list, set before linking
 
             Segment() {
                 items = new Basket[NODE_SIZE];
@@ -444,18 +1092,41 @@ namespace llic_queue {
                 delete[] items;
             }
 
+            // Called by the pool when the segment is recycled, keeps
+            // the basket array instead of allocating it again
+            void reset() {
+                for (std::size_t i = 0; i < NODE_SIZE; i++) {
+                    std::destroy_at(&items[i]);
+                    std::construct_at(&items[i]);
+                }
+                std::destroy_at(&HEAD);
+                std::construct_at(&HEAD);
+                std::destroy_at(&TAIL);
+                std::construct_at(&TAIL);
+                next.store(nullptr, std::memory_order_relaxed);
+                birthEra = 0;
+                id = 0;
+            }
+
+            // Baskets between the HEAD and TAIL of the segment
+            std::size_t size() {
+                Ticket h = HEAD.LL();
+                Ticket t = std::min<Ticket>(TAIL.LL(), NODE_SIZE);
+                return t > h ? t - h : 0;
+            }
+
             bool isFull() {
-                return TAIL.LL() >= (int)NODE_SIZE;
+                return TAIL.LL() >= NODE_SIZE;
             }
 
             bool isClosed() {
-                return HEAD.LL() >= (int)NODE_SIZE;
+                return HEAD.LL() >= NODE_SIZE;
             }
         };
 
         alignas(64) std::atomic<Segment*> Head;
         alignas(64) std::atomic<Segment*> Tail;
-        MemoryManagementPool<Segment> mm;
+        Reclaimer<Segment> mm;
 
     public:
         Queue(std::size_t max_threads = 64) {
@@ -470,6 +1141,15 @@ namespace llic_queue {
             delete Head.load();
         }
 
+        // Called by a thread that will not use the queue anymore
+        void release(std::size_t thread_id) {
+            mm.release(thread_id);
+        }
+
+        using ThreadRegistration<Queue>::enqueue;
+        using ThreadRegistration<Queue>::dequeue;
+        using ThreadRegistration<Queue>::approx_size;
+
         void enqueue(T* val, std::size_t thread_id)  {
             while (true) {
                 Segment* lastTail = mm.protectPointer(0, Tail.load(), thread_id);
@@ -479,11 +1159,12 @@ namespace llic_queue {
                     Tail.compare_exchange_strong(lastTail, lastNext);
                     continue;
                 }
-                long basketTicket = lastTail->TAIL.LL();
+                Ticket basketTicket = lastTail->TAIL.LL();
                 if (lastTail->isFull()) {
-                    Segment* newSegment = new Segment();
+                    Segment* newSegment = mm.allocate(thread_id);
                     Segment* nullSegment = nullptr;
                     newSegment->items[0].put(val);
+                    newSegment->id = lastTail->id + 1;
                     newSegment->TAIL.IC(basketTicket, thread_id);
                     if (lastTail->next.compare_exchange_strong(nullSegment, newSegment)) {
                         Tail.compare_exchange_strong(lastTail, newSegment);
@@ -501,11 +1182,36 @@ namespace llic_queue {
             }
         }
 
+        // Baskets between HEAD and TAIL, from the first and the last
+        // segment (the ones between them are full), writing only the
+        // hazard pointers of the caller. A basket holds between 0 and
+        // K items, and the result is off by the operations running
+        // concurrently.
+        std::size_t approx_size(std::size_t thread_id) {
+            Segment* lastHead = mm.protect(0, Head, thread_id);
+            uint64_t first = lastHead->id;
+            std::size_t size = lastHead->size();
+            Segment* lastTail = mm.protect(1, Tail, thread_id);
+            if (lastTail->id > first) {
+                size += lastTail->size() + (lastTail->id - first - 1) * NODE_SIZE;
+            }
+            mm.clear(thread_id);
+            return size;
+        }
+
         T* dequeue(std::size_t thread_id) {
             while (true) {
                 Segment* lastHead = mm.protectPointer(0, Head.load(), thread_id);
-                if (lastHead == nullptr) return nullptr;
+                if (lastHead == nullptr) {
+                    mm.clear(thread_id);
+                    return nullptr;
+                }
                 if (lastHead != Head.load()) continue;
+                // Read-only empty check, see BasketQueue::dequeue
+                if (lastHead->HEAD.LL() >= lastHead->TAIL.LL() && lastHead->next.load() == nullptr) {
+                    mm.clear(thread_id);
+                    return nullptr;
+                }
                 if (lastHead->isClosed()) {
                     Segment* next = lastHead->next.load();
                     if (Head.compare_exchange_strong(lastHead, next)) {
@@ -515,18 +1221,24 @@ namespace llic_queue {
                     mm.clear(thread_id);
                     continue;
                 }
-                long headTicket = lastHead->HEAD.LL();
-                long tailTicket = lastHead->TAIL.LL();
+                Ticket headTicket = lastHead->HEAD.LL();
+                Ticket tailTicket = lastHead->TAIL.LL();
 
                 while (!lastHead->isClosed()) {
                     if (headTicket < tailTicket) {
                         T* val = lastHead->items[headTicket].take();
-                        if (val != basket_closed_ptr<T>()) return val;
+                        if (val != basket_closed_ptr<T>()) {
+                            mm.clear(thread_id);
+                            return val;
+                        }
                         lastHead->HEAD.IC(headTicket, thread_id);
                     }
-                    long head = lastHead->HEAD.LL();
-                    long tail = lastHead->TAIL.LL();
-                    if ((headTicket == head) && (tail == tailTicket) && (headTicket == tailTicket)) return nullptr;
+                    Ticket head = lastHead->HEAD.LL();
+                    Ticket tail = lastHead->TAIL.LL();
+                    if ((headTicket == head) && (tail == tailTicket) && (headTicket == tailTicket)) {
+                        mm.clear(thread_id);
+                        return nullptr;
+                    }
                     headTicket = head;
                     tailTicket = tail;
                 }
@@ -534,6 +1246,63 @@ namespace llic_queue {
             return nullptr;
         }
     };
+
+    // Compile time enumeration of BasketQueue combinations. The
+    // product of the given LL/IC objects, baskets, segment policies
+    // and reclaimers is a TypeList of BasketQueue types.
+    template<typename... Ts>
+    struct TypeList {};
+
+    template<template<typename> class... Rs>
+    struct ReclaimerList {};
+
+    template<typename... Lists>
+    struct Concat {
+        using type = TypeList<>;
+    };
+
+    template<typename... As>
+    struct Concat<TypeList<As...>> {
+        using type = TypeList<As...>;
+    };
+
+    template<typename... As, typename... Bs, typename... Rest>
+    struct Concat<TypeList<As...>, TypeList<Bs...>, Rest...> : Concat<TypeList<As..., Bs...>, Rest...> {};
+
+    template<typename T, typename LLIC, typename Basket, typename Policy, typename Reclaimers>
+    struct ProductReclaimers;
+
+    template<typename T, typename LLIC, typename Basket, typename Policy, template<typename> class... Rs>
+    struct ProductReclaimers<T, LLIC, Basket, Policy, ReclaimerList<Rs...>> {
+        using type = TypeList<BasketQueue<T, LLIC, Basket, Policy, Rs>...>;
+    };
+
+    template<typename T, typename LLIC, typename Basket, typename Policies, typename Reclaimers>
+    struct ProductPolicies;
+
+    template<typename T, typename LLIC, typename Basket, typename... Ps, typename Reclaimers>
+    struct ProductPolicies<T, LLIC, Basket, TypeList<Ps...>, Reclaimers> {
+        using type = typename Concat<typename ProductReclaimers<T, LLIC, Basket, Ps, Reclaimers>::type...>::type;
+    };
+
+    template<typename T, typename LLIC, typename Baskets, typename Policies, typename Reclaimers>
+    struct ProductBaskets;
+
+    template<typename T, typename LLIC, typename... Bs, typename Policies, typename Reclaimers>
+    struct ProductBaskets<T, LLIC, TypeList<Bs...>, Policies, Reclaimers> {
+        using type = typename Concat<typename ProductPolicies<T, LLIC, Bs, Policies, Reclaimers>::type...>::type;
+    };
+
+    template<typename T, typename LLICs, typename Baskets, typename Policies, typename Reclaimers>
+    struct BasketQueueProduct;
+
+    template<typename T, typename... Ls, typename Baskets, typename Policies, typename Reclaimers>
+    struct BasketQueueProduct<T, TypeList<Ls...>, Baskets, Policies, Reclaimers> {
+        using type = typename Concat<typename ProductBaskets<T, Ls, Baskets, Policies, Reclaimers>::type...>::type;
+    };
+
+    template<typename T, typename LLICs, typename Baskets, typename Policies, typename Reclaimers>
+    using BasketQueueProduct_t = typename BasketQueueProduct<T, LLICs, Baskets, Policies, Reclaimers>::type;
 }
 
 #endif
@@ -0,0 +1,330 @@
+#ifndef _LPRQ_HPP_
+#define _LPRQ_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <atomic>
+#include <cassert>
+#include <limits>
+#include <array>
+#include "MemoryManagementPool.hpp"
+#include "ThreadHandle.hpp"
+
+// LPRQ (Romanov & Koval): the LCRQ of Morrison & Afek without CAS2.
+// Each cell keeps its (unsafe, index) word and its value in two
+// separate words, and the transitions that LCRQ does with one CAS2
+// are done with single word CAS:
+
+// - An enqueuer with ticket t first reserves the value of an empty
+//   cell with a marker of its own ticket, then moves the index word
+//   to ENQ | t and then replaces its marker by the item. If a
+//   dequeuer moves the index or takes back the marker in between,
+//   the enqueue of the ticket fails and a new ticket is taken.
+// - The ENQ bit is only set by enqueuers, so the CAS of an enqueuer
+//   always changes the index word and a dequeuer that read it before
+//   can not miss it.
+// - A dequeuer that finds the marker of an older ticket (or of its
+//   own ticket, after waiting for it) takes it back, so the enqueuer
+//   can not leave its item in a cell already consumed.
+
+// Cells are 64 bytes instead of the 128 bytes of the LCRQ nodes, and
+// the only read-modify-write operations are CAS, fetch&add and
+// fetch&or, so the queue builds on any target with 64-bit atomics.
+// Items must be aligned to 2 bytes at least (markers are odd).
+
+namespace lprq_queue {
+
+    constexpr int NODE_POW = 10;
+    constexpr std::size_t NODE_SIZE = 1ull << NODE_POW;
+    constexpr int STARVATION = 200000;
+
+    template<typename T, template<typename> class Reclaimer = MemoryManagementPool>
+    class Queue : public ThreadRegistration<Queue<T, Reclaimer>> {
+    private:
+
+        static constexpr uint64_t UNSAFE = 1ull << 63;
+        static constexpr uint64_t ENQ = 1ull << 62;
+        static constexpr uint64_t CLOSED = 1ull << 63;
+
+        struct alignas(64) Cell {
+            std::atomic<uint64_t> idx;
+            std::atomic<T*> val;
+        };
+
+        struct PRQ {
+            alignas(128) std::atomic<uint64_t> head;
+            alignas(128) std::atomic<uint64_t> tail;
+            alignas(128) std::atomic<PRQ*> next;
+            std::array<Cell, NODE_SIZE> ring;
+            uint64_t birthEra{0};
+            uint64_t id{0}; // Position in the list, set before linking
+
+            PRQ() {
+                for (unsigned i = 0; i < NODE_SIZE; i++) {
+                    ring[i].val.store(nullptr, std::memory_order_relaxed);
+                    ring[i].idx.store(i, std::memory_order_relaxed);
+                }
+                head.store(0, std::memory_order_relaxed);
+                tail.store(0, std::memory_order_relaxed);
+                next.store(nullptr, std::memory_order_relaxed);
+            };
+        };
+
+        alignas(64) std::atomic<PRQ*> head;
+        alignas(64) std::atomic<PRQ*> tail;
+        std::size_t m_max_threads;
+        Reclaimer<PRQ> mm;
+        // Thread id, with the row of mm when it keeps one (see ThreadHandle.hpp)
+        using Thread = thread_ref_t<Reclaimer<PRQ>>;
+
+        static T* marker(uint64_t ticket) {
+            return reinterpret_cast<T*>((ticket << 1) | 1);
+        }
+
+        static bool isMarker(T* val) {
+            return (reinterpret_cast<uintptr_t>(val) & 1) != 0;
+        }
+
+        static uint64_t markerTicket(T* val) {
+            return reinterpret_cast<uintptr_t>(val) >> 1;
+        }
+
+        static uint64_t cellIndex(uint64_t idx) {
+            return idx & ~(UNSAFE | ENQ);
+        }
+
+        static uint64_t tailIndex(uint64_t t) {
+            return t & ~CLOSED;
+        }
+
+        static bool prqIsClosed(uint64_t t) {
+            return (t & CLOSED) != 0;
+        }
+
+        // Items of one ring, its tail may have passed NODE_SIZE
+        // tickets beyond its head
+        std::size_t ringSize(PRQ* rq) {
+            uint64_t t = tailIndex(rq->tail.load());
+            uint64_t h = rq->head.load();
+            return t > h ? std::min<uint64_t>(t - h, NODE_SIZE) : 0;
+        }
+
+        // Read-only empty check before taking a head ticket. head is
+        // read before tail, so when it finds every enqueue ticket
+        // already given to a dequeuer and no next ring, the queue was
+        // empty when tail was read. Polling an empty queue then does
+        // not write the ring (no fetch&add on head, no fixState).
+        bool isEmpty(PRQ* lhead) {
+            uint64_t h = lhead->head.load();
+            return h >= tailIndex(lhead->tail.load()) && lhead->next.load() == nullptr;
+        }
+
+        void fixState(PRQ* lhead) {
+            while (true) {
+                uint64_t tail_idx = lhead->tail.load();
+                uint64_t head_idx = lhead->head.load();
+                if (lhead->tail.load() != tail_idx) continue;
+                if (head_idx > tail_idx) {
+                    if (lhead->tail.compare_exchange_strong(tail_idx, head_idx)) break;
+                    continue;
+                }
+                break;
+            }
+        }
+
+        bool closePRQ(PRQ* rq, const uint64_t tailTkt, const int tries) {
+            if (tries < 10) {
+                uint64_t tmp = tailTkt + 1;
+                return rq->tail.compare_exchange_strong(tmp, (tailTkt + 1) | CLOSED);
+            }
+            return (rq->tail.fetch_or(CLOSED) & CLOSED) == 0;
+        }
+
+        // Moves the index word of the cell to next (keeping the
+        // unsafe bit) while it is behind it
+        void advanceCell(Cell* cell, uint64_t next) {
+            uint64_t idx = cell->idx.load();
+            while (cellIndex(idx) < next
+                   && !cell->idx.compare_exchange_weak(idx, (idx & UNSAFE) | next));
+        }
+
+        bool enqueueTicket(PRQ* ltail, uint64_t tailTkt, T* elem) {
+            Cell* cell = &ltail->ring[tailTkt & (NODE_SIZE - 1)];
+            uint64_t idx = cell->idx.load();
+            T* val = cell->val.load();
+            if (val != nullptr || cellIndex(idx) > tailTkt) return false;
+            if ((idx & UNSAFE) && ltail->head.load() >= tailTkt) return false;
+            T* reserved = marker(tailTkt);
+            if (!cell->val.compare_exchange_strong(val, reserved)) return false;
+            if (!cell->idx.compare_exchange_strong(idx, ENQ | tailTkt)) {
+                cell->val.compare_exchange_strong(reserved, nullptr);
+                return false;
+            }
+            return cell->val.compare_exchange_strong(reserved, elem);
+        }
+
+        T* dequeueTicket(PRQ* lhead, uint64_t headTkt) {
+            Cell* cell = &lhead->ring[headTkt & (NODE_SIZE - 1)];
+            int r = 0;
+            uint64_t tt = 0;
+
+            while (true) {
+                uint64_t idx = cell->idx.load();
+                T* val = cell->val.load();
+                uint64_t index = cellIndex(idx);
+
+                if (index > headTkt) return nullptr;
+
+                if (val != nullptr && !isMarker(val)) {
+                    if (index == headTkt) {
+                        // Only the dequeuer of the ticket takes the item
+                        cell->val.store(nullptr);
+                        advanceCell(cell, headTkt + NODE_SIZE);
+                        return val;
+                    }
+                    // Item of an older cycle, its dequeuer is late
+                    if (cell->idx.compare_exchange_strong(idx, idx | UNSAFE)) return nullptr;
+                    continue;
+                }
+
+                if ((r & (NODE_SIZE - 1)) == 0) tt = lhead->tail.load();
+                bool starving = r > STARVATION;
+                if (val != nullptr) {
+                    // An enqueuer has reserved the cell
+                    uint64_t ticket = markerTicket(val);
+                    if (ticket > headTkt) return nullptr;
+                    if (ticket == headTkt && !starving && !prqIsClosed(tt)) {
+                        ++r;
+                        continue;
+                    }
+                    if (!cell->val.compare_exchange_strong(val, nullptr)) continue;
+                    advanceCell(cell, headTkt + NODE_SIZE);
+                    return nullptr;
+                }
+
+                if (idx & UNSAFE) {
+                    if (cell->idx.compare_exchange_strong(idx, UNSAFE | (headTkt + NODE_SIZE))) return nullptr;
+                } else if (tailIndex(tt) < headTkt + 1 || starving || prqIsClosed(tt)) {
+                    if (cell->idx.compare_exchange_strong(idx, headTkt + NODE_SIZE)) {
+                        if (starving && tt > NODE_SIZE) lhead->tail.fetch_or(CLOSED);
+                        return nullptr;
+                    }
+                } else {
+                    ++r;
+                }
+            }
+        }
+
+    public:
+        Queue(std::size_t max_threads = 64) : m_max_threads(max_threads) {
+            PRQ* sentinel = new PRQ();
+            head.store(sentinel, std::memory_order_relaxed);
+            tail.store(sentinel, std::memory_order_relaxed);
+        }
+
+        ~Queue() {
+            while (dequeue(0) != nullptr);
+            delete head.load();
+        };
+
+        // Called by a thread that will not use the queue anymore
+        void release(std::size_t thread_id) {
+            mm.release(thread_id);
+        }
+
+        using ThreadRegistration<Queue>::enqueue;
+        using ThreadRegistration<Queue>::dequeue;
+        using ThreadRegistration<Queue>::approx_size;
+
+        // Called once by the handle of each thread
+        Thread thread_ref(const int thread_id) {
+            return ::thread_ref(mm, thread_id);
+        }
+
+        void enqueue(T* elem, Thread thread_id) {
+            assert(!isMarker(elem) && "Elemento a insertar debe estar alineado");
+            int try_close = 0;
+            while (true) {
+                PRQ* ltail = mm.protectPointer(0, tail.load(), thread_id);
+                if (ltail != tail.load()) continue;
+                PRQ* lnext = ltail->next.load();
+                if (lnext != nullptr) {
+                    tail.compare_exchange_strong(ltail, lnext);
+                    continue;
+                }
+                uint64_t tailTkt = ltail->tail.fetch_add(1);
+                if (prqIsClosed(tailTkt)) {
+                    PRQ* newNode = mm.allocate(thread_id);
+                    newNode->id = ltail->id + 1;
+                    newNode->tail.store(1, std::memory_order_relaxed);
+                    newNode->ring[0].val.store(elem, std::memory_order_relaxed);
+                    newNode->ring[0].idx.store(ENQ, std::memory_order_relaxed);
+                    PRQ* nullNode = nullptr;
+                    if (ltail->next.compare_exchange_strong(nullNode, newNode)) {
+                        tail.compare_exchange_strong(ltail, newNode);
+                        mm.clear(thread_id);
+                        return;
+                    }
+                    delete newNode;
+                    continue;
+                }
+                if (enqueueTicket(ltail, tailTkt, elem)) {
+                    mm.clear(thread_id);
+                    return;
+                }
+                if ((int64_t)(tailTkt - ltail->head.load()) >= (int64_t)NODE_SIZE
+                    && closePRQ(ltail, tailTkt, ++try_close)) continue;
+            }
+        };
+
+        // Items of the rings, from their head and tail tickets,
+        // without writing shared state (only the hazard pointers of
+        // the caller). The rings between the first and the last one
+        // are counted as full, they are closed when full except under
+        // livelock (at most NODE_SIZE items more per such ring). The
+        // result is also off by the operations running concurrently,
+        // as the ends are read at different times.
+        std::size_t approx_size(Thread thread_id) {
+            PRQ* lhead = mm.protect(0, head, thread_id);
+            uint64_t first = lhead->id;
+            std::size_t size = ringSize(lhead);
+            PRQ* ltail = mm.protect(1, tail, thread_id);
+            if (ltail->id > first) {
+                size += ringSize(ltail) + (ltail->id - first - 1) * NODE_SIZE;
+            }
+            mm.clear(thread_id);
+            return size;
+        }
+
+        T* dequeue(Thread thread_id) {
+            while (true) {
+                PRQ* lhead = mm.protectPointer(0, head.load(), thread_id);
+                if (lhead != head.load()) continue;
+                if (isEmpty(lhead)) {
+                    mm.clear(thread_id);
+                    return nullptr;
+                }
+                uint64_t headTkt = lhead->head.fetch_add(1);
+                T* val = dequeueTicket(lhead, headTkt);
+                if (val != nullptr) {
+                    mm.clear(thread_id);
+                    return val;
+                }
+                if (tailIndex(lhead->tail.load()) <= headTkt + 1) {
+                    fixState(lhead);
+                    PRQ* lnext = lhead->next.load();
+                    if (lnext == nullptr) {
+                        mm.clear(thread_id);
+                        return nullptr;
+                    }
+                    if (tailIndex(lhead->tail.load()) <= headTkt + 1) {
+                        if (head.compare_exchange_strong(lhead, lnext)) mm.retire(lhead, thread_id);
+                    }
+                }
+            }
+        }
+    };
+
+};
+
+#endif
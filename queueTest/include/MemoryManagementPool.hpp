@@ -1,8 +1,19 @@
 #ifndef _Memory_Management_Pool_HPP_
 #define _Memory_Management_Pool_HPP_
 
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "ThreadRegistry.hpp"
+#include "Intrusive.hpp"
 
 
 // We need a memory management tool. This tool must provide the
@@ -16,91 +27,218 @@
 
 // - void protect(T* value, int thread_id): this method protects the pointer from being deleted by others threads.
 // - boolean retire(T* value, int thread_id): This method tries retire a pointer if possible. This means that the pointer will be deleted only if it is not used by another threads and it is safe delete it
-
-template <typename T>
+// - T* allocate(int thread_id, Args... args): returns an object from the pool, or a new one if the pool is empty. The queues use it instead of new.
+
+// Reclaimed objects are not deleted but kept in a per-thread free
+// list of POOL_THREAD_MAX objects. When the list is full they go to a
+// shared list of POOL_SHARED_MAX objects protected by a try-lock (if
+// the lock is taken, the object is deleted instead of waiting). A
+// recycled object is re-initialized with its reset(args...) method
+// when T has one, otherwise it is destroyed and constructed again in
+// place. Either way no malloc/free happens in steady state. Objects
+// with a dispose() member (see Intrusive.hpp) are not pooled, they
+// are disposed when reclaimed.
+
+// With Asymmetric = true, protect publishes the hazard pointer with a
+// relaxed store and a compiler-only fence, and retire runs
+// membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED) before the scan, which
+// executes a full fence on every running thread of the process. The
+// readers stop paying a fence per pointer, the (rare) scans pay a
+// system call. If the kernel does not support the expedited command,
+// the pool falls back to the seq_cst stores at runtime.
+
+template <typename T, bool Asymmetric = false>
 class MemoryManagementPool {
 private:
     static const int HP_THREADS_MAX = 64;
     static const int HP_K_MAX = 4;
-    static const int CL_PAD = 64 / sizeof(std::atomic<T*>);
-    // static const int HP_THRESHOLD_R = CL_PAD / 4;
+    static const std::size_t POOL_THREAD_MAX = 8;
+    static const std::size_t POOL_SHARED_MAX = 64;
 
-    std::atomic<T*>* hp[HP_THREADS_MAX];
-    std::vector<T*> retiredList[HP_THREADS_MAX * CL_PAD];
+    // State of one thread, registered on its first operation
+    struct alignas(128) Row {
+        std::atomic<T*> hp[HP_K_MAX]{};
+        std::vector<T*> retired;
+        std::vector<T*> hazards; // Scan buffer
+        std::vector<T*> freeList;
+    };
+
+public:
+    // Thread id that carries the address of its row (see
+    // ThreadRegistry::Ref), the methods also take a plain id
+    using Thread = typename ThreadRegistry<Row>::Ref;
+
+private:
+    ThreadRegistry<Row> registry;
+    std::vector<T*> sharedFreeList;
+    std::mutex sharedLock;
 
     const int max_HP;
     const int max_Threads;
     const std::size_t threshold;
+    const bool useMembarrier;
+
+    // Registers the process once, the result is shared by all the pools
+    static bool membarrierAvailable() {
+        static const bool available = [] {
+            long cmds = syscall(SYS_membarrier, MEMBARRIER_CMD_QUERY, 0, 0);
+            if (cmds < 0 || !(cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) return false;
+            return syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+        }();
+        return available;
+    }
 
-public:
-    MemoryManagementPool(int max_HP = HP_K_MAX, int max_threads = HP_THREADS_MAX) :
-        max_HP(max_HP), max_Threads(max_threads), threshold (2 * (max_threads * HP_K_MAX)) {
-        for (int ith = 0; ith < HP_THREADS_MAX; ith++) {
-            hp[ith] = new std::atomic<T*>[CL_PAD * 2];
-            for (int ihp = 0; ihp < HP_K_MAX; ihp++) {
-                hp[ith][ihp].store(nullptr, std::memory_order_relaxed);
+    void publish(int hp_idx, T* pointer, Thread thread_id) {
+        std::atomic<T*>& slot = registry.get(thread_id).hp[hp_idx];
+        if (useMembarrier) {
+            slot.store(pointer, std::memory_order_relaxed);
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } else {
+            slot.store(pointer, std::memory_order_seq_cst);
+        }
+    }
+
+    void recycle(T* obj, std::vector<T*>& local) {
+        if constexpr (is_disposable_v<T>) {
+            obj->dispose();
+            return;
+        }
+        if (local.size() < POOL_THREAD_MAX) {
+            local.push_back(obj);
+            return;
+        }
+        if (sharedLock.try_lock()) {
+            if (sharedFreeList.size() < POOL_SHARED_MAX) {
+                sharedFreeList.push_back(obj);
+                obj = nullptr;
             }
+            sharedLock.unlock();
         }
+        delete obj;
     }
 
-    ~MemoryManagementPool() {
-        for (int ith = 0; ith < HP_THREADS_MAX; ith++) {
-            delete[] hp[ith];
-            for (unsigned irl = 0; irl < retiredList[ith * CL_PAD].size(); irl++) {
-                delete retiredList[ith * CL_PAD][irl];
+    T* reuse(Thread thread_id) {
+        std::vector<T*>& local = registry.get(thread_id).freeList;
+        T* obj = nullptr;
+        if (!local.empty()) {
+            obj = local.back();
+            local.pop_back();
+        } else if (sharedLock.try_lock()) {
+            if (!sharedFreeList.empty()) {
+                obj = sharedFreeList.back();
+                sharedFreeList.pop_back();
             }
+            sharedLock.unlock();
+        }
+        return obj;
+    }
+
+public:
+    MemoryManagementPool(int max_HP = HP_K_MAX, int max_threads = HP_THREADS_MAX) :
+        max_HP(max_HP), max_Threads(max_threads), threshold (2 * (max_threads * HP_K_MAX)),
+        useMembarrier(Asymmetric && membarrierAvailable()) {
+        assert(max_HP <= HP_K_MAX && "Demasiados hazard pointers por hilo");
+    }
+
+    ~MemoryManagementPool() {
+        registry.forEach([](Row& row) {
+            for (T* obj : row.retired) dispose_object(obj);
+            for (T* obj : row.freeList) delete obj;
+        });
+        for (T* obj : sharedFreeList) {
+            delete obj;
         }
     }
 
-    void clear(const int thread_id) {
+    static std::string name() {
+        return Asymmetric ? "AHP" : "HP";
+    }
+
+    // Called once by the handle of a thread, see ThreadHandle.hpp
+    Thread thread_ref(const int thread_id) {
+        return registry.ref(thread_id);
+    }
+
+    template<typename... Args>
+    T* allocate(Thread thread_id, Args&&... args) {
+        T* obj = reuse(thread_id);
+        if (obj == nullptr) return new T(std::forward<Args>(args)...);
+        if constexpr (requires { obj->reset(std::forward<Args>(args)...); }) {
+            obj->reset(std::forward<Args>(args)...);
+        } else {
+            std::destroy_at(obj);
+            std::construct_at(obj, std::forward<Args>(args)...);
+        }
+        return obj;
+    }
+
+    void clear(Thread thread_id) {
+        Row& row = registry.get(thread_id);
         for (int ihp = 0; ihp < max_HP; ihp++) {
-            hp[thread_id][ihp].store(nullptr, std::memory_order_release);
+            row.hp[ihp].store(nullptr, std::memory_order_release);
         }
     }
 
-    void clearOne(int hp_idx, const int thread_id) {
-        hp[thread_id][hp_idx].store(nullptr, std::memory_order_release);
+    void clearOne(int hp_idx, Thread thread_id) {
+        registry.get(thread_id).hp[hp_idx].store(nullptr, std::memory_order_release);
     }
 
-    T* protect(int hp_idx, const std::atomic<T*>& atom, const int thread_id) {
+    // The thread leaves the pool: its hazard pointers are cleared and
+    // the scans stop visiting its row. Its retired objects stay in
+    // the row until the id is used again or the pool is destroyed.
+    void release(const int thread_id) {
+        clear(thread_id);
+        registry.release(thread_id);
+    }
+
+    T* protect(int hp_idx, const std::atomic<T*>& atom, Thread thread_id) {
         T* n = nullptr;
         T* ret;
         while ((ret = atom.load()) != n) {
-            hp[thread_id][hp_idx].store(ret, std::memory_order_seq_cst);
+            publish(hp_idx, ret, thread_id);
             n = ret;
         }
         return ret;
     }
 
-    T* protectPointer(int hp_idx, T* pointer, const int thread_id) {
-        hp[thread_id][hp_idx].store(pointer);
+    T* protectPointer(int hp_idx, T* pointer, Thread thread_id) {
+        publish(hp_idx, pointer, thread_id);
         return pointer;
     }
 
-    bool retire(T* ptr, const int thread_id) {
-        retiredList[thread_id * CL_PAD].push_back(ptr);
-        if (retiredList[thread_id * CL_PAD].size() < threshold) return false;
-        for (unsigned irl = 0; irl < retiredList[thread_id * CL_PAD].size();) {
-            auto obj = retiredList[thread_id * CL_PAD][irl];
-            bool canDelete = true;
-            for (int tid = 0; tid < max_Threads && canDelete; tid++) {
-                for (int hp_idx = max_HP - 1; hp_idx >= 0; hp_idx--) {
-                    if (hp[tid][hp_idx].load() == obj) {
-                        canDelete = false;
-                        break;
-                    }
-                }
+    // The scan takes one snapshot of the hazard pointers of the live
+    // threads and sorts it, so each retired object is checked in
+    // O(log H). The survivors are compacted in the same pass.
+    bool retire(T* ptr, Thread thread_id) {
+        Row& row = registry.get(thread_id);
+        std::vector<T*>& retired = row.retired;
+        retired.push_back(ptr);
+        if (retired.size() < threshold) return false;
+        if (useMembarrier) syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+        std::vector<T*>& snapshot = row.hazards;
+        snapshot.clear();
+        registry.forEachLive([&snapshot, this](Row& other) {
+            for (int hp_idx = 0; hp_idx < max_HP; hp_idx++) {
+                T* obj = other.hp[hp_idx].load();
+                if (obj != nullptr) snapshot.push_back(obj);
             }
-            if (canDelete) {
-                retiredList[thread_id * CL_PAD].erase(retiredList[thread_id * CL_PAD].begin() + irl);
-                delete obj;
-                continue;
+        });
+        std::sort(snapshot.begin(), snapshot.end());
+        std::size_t kept = 0;
+        for (T* obj : retired) {
+            if (std::binary_search(snapshot.begin(), snapshot.end(), obj)) {
+                retired[kept++] = obj;
+            } else {
+                recycle(obj, row.freeList);
             }
-            irl++;
         }
+        retired.resize(kept);
         return true;
     }
 
 };
 
+template <typename T>
+using AsymmetricHazardPool = MemoryManagementPool<T, true>;
+
 #endif
@@ -2,20 +2,29 @@
 #define _MICHAEL_SCOTT_QUEUE_HP_H_
 
 #include <atomic>
+#include <cstdint>
 #include <stdexcept>
 #include <cassert>
+#include <memory>
+#include <type_traits>
 #include "MemoryManagementPool.hpp"
+#include "Backoff.hpp"
+#include "Intrusive.hpp"
+#include "ThreadHandle.hpp"
 
 namespace ms_queue {
 
-    template<typename T>
-    class Queue {
+    template<typename T, template<typename> class Reclaimer = MemoryManagementPool,
+             typename Backoff = NoBackoff>
+    class Queue : public ThreadRegistration<Queue<T, Reclaimer, Backoff>> {
 
     private:
 
         struct Node {
             T* item;
             std::atomic<Node*> next;
+            uint64_t birthEra{0};
+            uint64_t index{0}; // Position in the list, set before linking
 
             Node(T* userItem) : item{userItem}, next{nullptr} { }
 
@@ -30,7 +39,9 @@ namespace ms_queue {
         static const int MAX_THREADS = 128;
         std::size_t maxThreads;
 
-        MemoryManagementPool<Node> mm;
+        Reclaimer<Node> mm;
+        // Thread id, with the row of mm when it keeps one (see ThreadHandle.hpp)
+        using Thread = thread_ref_t<Reclaimer<Node>>;
 
     public:
         Queue(std::size_t maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
@@ -44,20 +55,38 @@ namespace ms_queue {
             delete head.load();
         }
 
-        void enqueue(T* item, const int tid) {
+        // Called by a thread that will not use the queue anymore
+        void release(std::size_t thread_id) {
+            mm.release(thread_id);
+        }
+
+        using ThreadRegistration<Queue>::enqueue;
+        using ThreadRegistration<Queue>::dequeue;
+        using ThreadRegistration<Queue>::approx_size;
+
+        // Called once by the handle of each thread
+        Thread thread_ref(const int thread_id) {
+            return ::thread_ref(mm, thread_id);
+        }
+
+        void enqueue(T* item, Thread tid) {
             assert(item != nullptr && "Elemento a insertar no puede ser nullptr");
-            Node* newNode = new Node(item);
+            Node* newNode = mm.allocate(tid, item);
             Node* nullNode = nullptr;
+            static thread_local Backoff backoff;
             while (true) {
                 Node* ltail = mm.protectPointer(0, tail.load(), tid);
                 if (ltail == tail.load()) {
                     Node* lnext = ltail->next.load();
                     if (lnext == nullptr) {
+                        newNode->index = ltail->index + 1;
                         if (ltail->next.compare_exchange_strong(nullNode, newNode)) {
                             tail.compare_exchange_strong(ltail, newNode);
                             mm.clear(tid);
+                            backoff.reset();
                             return;
                         }
+                        backoff();
                     } else {
                         tail.compare_exchange_strong(ltail, lnext);
                     }
@@ -66,16 +95,151 @@ namespace ms_queue {
         }
 
 
-        T* dequeue(const int tid) {
+        // Nodes between HEAD and TAIL, without writing shared state
+        // (only the hazard pointers of the caller). Exact when no
+        // operation is running, otherwise off by at most the number
+        // of concurrent operations (TAIL may lag one node per pending
+        // enqueue, and the ends are read at different times).
+        std::size_t approx_size(Thread tid) {
+            Node* lhead = mm.protect(0, head, tid);
+            uint64_t first = lhead->index;
+            Node* ltail = mm.protect(1, tail, tid);
+            uint64_t last = ltail->index;
+            mm.clear(tid);
+            return last > first ? last - first : 0;
+        }
+
+        T* dequeue(Thread tid) {
             Node* node = mm.protect(0, head, tid);
+            static thread_local Backoff backoff;
             while (node != tail.load()) {
                 Node* lnext = mm.protect(1, node->next, tid);
                 if (head.compare_exchange_strong(node, lnext)) {
+                    backoff.reset();
                     T* item = lnext->item;
                     mm.clear(tid);
                     mm.retire(node, tid);
                     return item;
                 }
+                backoff();
+                node = mm.protect(0, head, tid);
+            }
+            mm.clear(tid);
+            return nullptr;
+        }
+    };
+
+    // Intrusive version: T derives from IntrusiveHook and the items
+    // are the nodes of the list, so enqueue allocates nothing. The
+    // initial sentinel is a hook owned by the queue. A dequeued item
+    // becomes the sentinel and is retired by the next dequeue. It is
+    // given to Disposer once the reclaimer finds it unreachable and
+    // the consumer called done(item) (see Intrusive.hpp).
+    template<typename T, typename Disposer = std::default_delete<T>,
+             template<typename> class Reclaimer = MemoryManagementPool,
+             typename Backoff = NoBackoff>
+    class IntrusiveQueue : public ThreadRegistration<IntrusiveQueue<T, Disposer, Reclaimer, Backoff>> {
+
+    private:
+        static_assert(std::is_base_of_v<IntrusiveHook, T>, "T debe derivar de IntrusiveHook");
+
+        using Hook = IntrusiveHook;
+
+        alignas(128) std::atomic<Hook*> head;
+        alignas(128) std::atomic<Hook*> tail;
+        Hook sentinel;
+
+        static const int MAX_THREADS = 128;
+        std::size_t maxThreads;
+
+        Reclaimer<Hook> mm;
+        // Thread id, with the row of mm when it keeps one (see ThreadHandle.hpp)
+        using Thread = thread_ref_t<Reclaimer<Hook>>;
+
+        static void disposeItem(Hook* hook) {
+            Disposer{}(static_cast<T*>(hook));
+        }
+
+    public:
+        IntrusiveQueue(std::size_t maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+            head.store(&sentinel, std::memory_order_relaxed);
+            tail.store(&sentinel, std::memory_order_relaxed);
+        }
+
+        // The items still linked are disposed, the last sentinel too
+        ~IntrusiveQueue() {
+            T* item;
+            while ((item = dequeue(0)) != nullptr) done(item);
+            head.load()->dispose();
+        }
+
+        // Called by a thread that will not use the queue anymore
+        void release(std::size_t thread_id) {
+            mm.release(thread_id);
+        }
+
+        using ThreadRegistration<IntrusiveQueue>::enqueue;
+        using ThreadRegistration<IntrusiveQueue>::dequeue;
+        using ThreadRegistration<IntrusiveQueue>::approx_size;
+
+        // Called once by the handle of each thread
+        Thread thread_ref(const int thread_id) {
+            return ::thread_ref(mm, thread_id);
+        }
+
+        void enqueue(T* item, Thread tid) {
+            assert(item != nullptr && "Elemento a insertar no puede ser nullptr");
+            Hook* newNode = item;
+            newNode->link(&disposeItem);
+            Hook* nullNode = nullptr;
+            static thread_local Backoff backoff;
+            while (true) {
+                Hook* ltail = mm.protectPointer(0, tail.load(), tid);
+                if (ltail == tail.load()) {
+                    Hook* lnext = ltail->next.load();
+                    if (lnext == nullptr) {
+                        newNode->index = ltail->index + 1;
+                        if (ltail->next.compare_exchange_strong(nullNode, newNode)) {
+                            tail.compare_exchange_strong(ltail, newNode);
+                            mm.clear(tid);
+                            backoff.reset();
+                            return;
+                        }
+                        backoff();
+                    } else {
+                        tail.compare_exchange_strong(ltail, lnext);
+                    }
+                }
+            }
+        }
+
+        // Same bounds as Queue::approx_size
+        std::size_t approx_size(Thread tid) {
+            Hook* lhead = mm.protect(0, head, tid);
+            uint64_t first = lhead->index;
+            Hook* ltail = mm.protect(1, tail, tid);
+            uint64_t last = ltail->index;
+            mm.clear(tid);
+            return last > first ? last - first : 0;
+        }
+
+        // Drops the reference of the consumer to a dequeued item
+        void done(T* item) {
+            item->dispose();
+        }
+
+        T* dequeue(Thread tid) {
+            Hook* node = mm.protect(0, head, tid);
+            static thread_local Backoff backoff;
+            while (node != tail.load()) {
+                Hook* lnext = mm.protect(1, node->next, tid);
+                if (head.compare_exchange_strong(node, lnext)) {
+                    backoff.reset();
+                    mm.clear(tid);
+                    if (node != &sentinel) mm.retire(node, tid);
+                    return static_cast<T*>(lnext);
+                }
+                backoff();
                 node = mm.protect(0, head, tid);
             }
             mm.clear(tid);
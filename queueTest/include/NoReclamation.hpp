@@ -0,0 +1,87 @@
+#ifndef _No_Reclamation_HPP_
+#define _No_Reclamation_HPP_
+
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ThreadRegistry.hpp"
+#include "Intrusive.hpp"
+
+
+// Reclaimer with the same interface as MemoryManagementPool that
+// never frees memory while the data structure is alive. Retired
+// objects are kept in a per-thread list (a ThreadRegistry row) and
+// deleted when the pool is destroyed.
+
+// It is useful as a baseline to measure the cost of a reclamation
+// scheme, and for structures whose live window is bounded by its
+// construction parameters.
+
+template <typename T>
+class NoReclamation {
+private:
+    static const int THREADS_MAX = 64;
+
+    struct alignas(128) Row {
+        std::vector<T*> retired;
+    };
+
+    ThreadRegistry<Row> registry;
+
+public:
+    NoReclamation(int max_HP = 0, int max_threads = THREADS_MAX) {
+        (void) max_HP;
+        (void) max_threads;
+    }
+
+    ~NoReclamation() {
+        registry.forEach([](Row& row) {
+            for (T* obj : row.retired) {
+                dispose_object(obj);
+            }
+        });
+    }
+
+    static std::string name() {
+        return "NR";
+    }
+
+    template<typename... Args>
+    T* allocate(const int thread_id, Args&&... args) {
+        (void) thread_id;
+        return new T(std::forward<Args>(args)...);
+    }
+
+    void clear(const int thread_id) {
+        (void) thread_id;
+    }
+
+    void clearOne(int hp_idx, const int thread_id) {
+        (void) hp_idx;
+        (void) thread_id;
+    }
+
+    void release(const int thread_id) {
+        (void) thread_id;
+    }
+
+    T* protect(int hp_idx, const std::atomic<T*>& atom, const int thread_id) {
+        (void) hp_idx;
+        (void) thread_id;
+        return atom.load();
+    }
+
+    T* protectPointer(int hp_idx, T* pointer, const int thread_id) {
+        (void) hp_idx;
+        (void) thread_id;
+        return pointer;
+    }
+
+    bool retire(T* ptr, const int thread_id) {
+        registry.get(thread_id).retired.push_back(ptr);
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _Roles_HPP_
+#define _Roles_HPP_
+
+#include <string>
+
+
+// Number of threads on each side of a queue, fixed at compile time.
+// With Single, the queue trusts that only one thread enqueues (or
+// dequeues) and replaces the read-modify-write operations that
+// coordinate that side (fetch&add of the indices, CAS of the head or
+// tail) by loads and stores. The other side keeps its synchronization,
+// so a cell shared by both sides is still claimed with a CAS or an
+// exchange.
+
+// Using a Single side from several threads is undefined behaviour.
+
+struct SingleRole {
+    static constexpr bool single = true;
+
+    static std::string name() {
+        return "S";
+    }
+};
+
+struct MultiRole {
+    static constexpr bool single = false;
+
+    static std::string name() {
+        return "M";
+    }
+};
+
+struct ProducerPolicy {
+    using Single = SingleRole;
+    using Multi = MultiRole;
+};
+
+struct ConsumerPolicy {
+    using Single = SingleRole;
+    using Multi = MultiRole;
+};
+
+#endif
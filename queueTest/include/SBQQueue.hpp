@@ -8,6 +8,9 @@
 #include <limits>
 #include <array>
 #include "MemoryManagementPool.hpp"
+#include "ThreadRegistry.hpp"
+#include "Backoff.hpp"
+#include "ThreadHandle.hpp"
 
 namespace scal_basket_queue {
     static constexpr int MAX_THREADS = 64;
@@ -23,8 +26,8 @@ namespace scal_basket_queue {
         return reinterpret_cast<T*>(std::numeric_limits<uint64_t>::min());
     }
 
-    template<typename T>
-    class Queue {
+    template<typename T, typename Backoff = NoBackoff>
+    class Queue : public ThreadRegistration<Queue<T, Backoff>> {
     private:
 
         struct Basket {
@@ -38,9 +41,11 @@ namespace scal_basket_queue {
                 }
             }
 
+            // Threads above ENQUEUERS share cells, a taken cell makes
+            // the insert fail as if the basket was closed
             bool insert(T* elem, std::size_t thread_id) {
                 T* nullVal = nullptr;
-                return cells[thread_id].compare_exchange_strong(nullVal, elem);
+                return cells[thread_id % ENQUEUERS].compare_exchange_strong(nullVal, elem);
             }
 
             T* extract() {
@@ -73,35 +78,47 @@ namespace scal_basket_queue {
         alignas(128) std::atomic<Node*> head;
         alignas(128) std::atomic<Node*> tail;
         std::atomic<Node*> retired;
-        Node* protectors[ENQUEUERS];
+
+        // node is the hazard of the thread. spare is a node that was
+        // allocated by an enqueue but never linked (the element went
+        // to an existing basket), kept for the next enqueue.
+        struct alignas(128) Protector {
+            std::atomic<Node*> node{nullptr};
+            Node* spare{nullptr};
+        };
+
+        ThreadRegistry<Protector> protectors;
+        // Thread id with its protector, see ThreadHandle.hpp
+        using Thread = typename ThreadRegistry<Protector>::Ref;
         // MemoryManagementPool<Node> mm;
         std::size_t maxThreads;
 
         enum class Status {BAD_TAIL, SUCCESS, FAILURE};
 
-        Node* protect(std::atomic<Node*>& ptr, Node** p) {
+        Node* protect(std::atomic<Node*>& ptr, Protector& p) {
             while (true) {
-                *p = ptr.load();
+                Node* node = ptr.load();
+                p.node.store(node, std::memory_order_relaxed);
                 std::atomic_thread_fence(std::memory_order_seq_cst);
-                if (ptr.load() == *p)  return *p;
+                if (ptr.load() == node)  return node;
             }
         }
 
-        void unprotect(Node** p) {
-            *p = nullptr;
+        void unprotect(Protector& p) {
+            p.node.store(nullptr, std::memory_order_release);
         }
 
         void freeNodes() {
             Node* ret = retired.exchange(nullptr);
             if (ret == nullptr) return;
             int index = INT32_MAX;
-            for (unsigned i = 0; i < ENQUEUERS; i++) {
-                Node* p = protectors[i];
+            protectors.forEachLive([&index](Protector& protector) {
+                Node* p = protector.node.load();
                 if (p != nullptr) {
                     int idx = p->index;
                     if (idx < index) index = idx;
                 }
-            }
+            });
             while (ret != head.load() and ret->index < index) {
                 Node* tmp = ret->next.load();
                 delete ret;
@@ -117,50 +134,75 @@ namespace scal_basket_queue {
             head.store(sentinel, std::memory_order_relaxed);
             tail.store(sentinel, std::memory_order_relaxed);
             retired.store(sentinel, std::memory_order_relaxed);
-            for (unsigned i = 0; i < ENQUEUERS; i++) {
-                protectors[i] = nullptr;
-            }
         }
 
         ~Queue() {
             while (dequeue(0) != nullptr);
+            protectors.forEach([](Protector& protector) {
+                delete protector.spare;
+            });
             delete head.load();
             // delete tail.load();
         }
 
-        void enqueue(T* elem, std::size_t thread_id) {
+        using ThreadRegistration<Queue>::enqueue;
+        using ThreadRegistration<Queue>::dequeue;
+        using ThreadRegistration<Queue>::approx_size;
+
+        // Called once by the handle of each thread
+        Thread thread_ref(const int thread_id) {
+            return protectors.ref(thread_id);
+        }
+
+        void enqueue(T* elem, Thread thread_id) {
             assert(elem != nullptr && "Elemento a insertar no puede ser nullptr");
-            Node* t = protect(tail, &protectors[thread_id]);
+            Protector& protector = protectors.get(thread_id);
+            Node* t = protect(tail, protector);
             // Node* t = mm.protect(0, tail, thread_id);
-            Node* newNode = new Node();
+            Node* newNode = protector.spare;
+            protector.spare = nullptr;
+            if (newNode == nullptr) newNode = new Node();
             newNode->basket.insert(elem, thread_id);
+            static thread_local Backoff backoff;
             while (true) {
                 t = tail.load();
                 newNode->index = t->index + 1;
                 Status status = tryAppend(t, newNode);
                 if (status == Status::SUCCESS) {
                     tail.compare_exchange_strong(t, newNode);
-                    unprotect(&protectors[thread_id]);
+                    unprotect(protector);
+                    backoff.reset();
                     return;
                 } else if (status == Status::FAILURE) {
                     t = tail.load();
                     if (t->basket.insert(elem, thread_id)) {
-                        delete newNode;
+                        // newNode was never linked, only its cell is used
+                        newNode->basket.cells[thread_id % ENQUEUERS].store(nullptr, std::memory_order_relaxed);
+                        protector.spare = newNode;
                         break;
                     }
+                    backoff();
                 }
                 while (t->next != nullptr) {
                     t = t->next;
                 }
                 advanceNode(tail, t);
             }
-            unprotect(&protectors[thread_id]);
+            unprotect(protector);
+            backoff.reset();
             // mm.clear(thread_id);
         }
 
-        T* dequeue(std::size_t thread_id) {
-            Node* h = protect(head, &protectors[thread_id]);
+        T* dequeue(Thread thread_id) {
+            Protector& protector = protectors.get(thread_id);
+            Node* h = protect(head, protector);
             // Node* h = mm.protect(0, head, thread_id);
+            // Read-only empty check, it skips advanceNode and the
+            // exchange of freeNodes
+            if (h->basket.isEmpty() && h->next.load() == nullptr) {
+                unprotect(protector);
+                return nullptr;
+            }
             T* element = nullptr;
             while (true) {
                 while (h->basket.isEmpty() && h->next.load() != nullptr) {
@@ -173,10 +215,30 @@ namespace scal_basket_queue {
             }
             advanceNode(head, h);
             freeNodes();
-            unprotect(&protectors[thread_id]);
+            unprotect(protector);
             return element;
         }
 
+        // Baskets between HEAD and TAIL that still hold items, from
+        // the basket indices, writing only the protector of the
+        // caller. A basket holds between 1 and ENQUEUERS items when it
+        // is appended and may be partly drained, so this is the size
+        // within a factor of ENQUEUERS (exact if each enqueue appended
+        // its own basket), plus the operations running concurrently.
+        std::size_t approx_size(Thread thread_id) {
+            Protector& protector = protectors.get(thread_id);
+            Node* h = protect(head, protector);
+            int first = h->index + (h->basket.isEmpty() ? 1 : 0);
+            int last = protect(tail, protector)->index;
+            unprotect(protector);
+            return last >= first ? last - first + 1 : 0;
+        }
+
+        // The thread stops taking part in the scans of freeNodes
+        void release(std::size_t thread_id) {
+            protectors.release(thread_id);
+        }
+
         Status tryAppend(Node* tail, Node* newNode) {
             Node* nullValue = nullptr;
             if (tail->next.load() != nullptr) return Status::BAD_TAIL;
@@ -184,10 +246,15 @@ namespace scal_basket_queue {
         }
 
         void advanceNode(std::atomic<Node*>& ptr, Node* newNode) {
+            static thread_local Backoff backoff;
             while (true) {
                 Node* oldNode = ptr.load();
                 if (oldNode->index >= newNode->index) return;
-                if (ptr.compare_exchange_strong(oldNode, newNode)) return;
+                if (ptr.compare_exchange_strong(oldNode, newNode)) {
+                    backoff.reset();
+                    return;
+                }
+                backoff();
             }
         }
 
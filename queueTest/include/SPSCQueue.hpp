@@ -0,0 +1,120 @@
+#ifndef _SPSC_QUEUE_HPP_
+#define _SPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "Backoff.hpp"
+#include "ThreadHandle.hpp"
+
+// Bounded ring for one producer and one consumer (Lamport, with the
+// cache optimizations of FastForward and MCRingBuffer). It is the
+// baseline of the battery: a link between two threads that does no
+// read-modify-write operation, so the results of the MPMC queues can
+// be normalized against it.
+
+// - Each side owns its index and keeps a cached copy of the index of
+//   the other side. The remote index is only read again when the
+//   cached one says that the ring is full (producer) or empty
+//   (consumer), so in steady state each operation touches its own
+//   cache lines and the slot.
+// - The producer publishes tail on every enqueue (a release store).
+//   The consumer publishes head once every BATCH dequeues, or when it
+//   finds the ring empty, so the producer sees up to BATCH slots less
+//   than the ones freed.
+// - try_enqueue and dequeue are wait-free. enqueue waits while the
+//   ring is full, like the other queues it never fails.
+
+// thread_id is only kept for the interface of the harness. Calling
+// enqueue from two threads (or dequeue from two threads) is undefined
+// behaviour.
+
+namespace spsc_queue {
+
+    template<typename T, std::size_t CAPACITY = 1ull << 16, std::size_t BATCH = 64>
+    class Queue : public ThreadRegistration<Queue<T, CAPACITY, BATCH>> {
+    private:
+        static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY debe ser potencia de dos");
+        static_assert(BATCH < CAPACITY, "BATCH debe ser menor que CAPACITY");
+
+        static constexpr std::size_t MASK = CAPACITY - 1;
+
+        // Producer
+        alignas(128) std::atomic<uint64_t> tail{0};
+        alignas(128) uint64_t headCache{0};
+        // Consumer
+        alignas(128) std::atomic<uint64_t> head{0};
+        alignas(128) uint64_t next{0};
+        uint64_t tailCache{0};
+        // The slots are ordered by the stores of the indices
+        alignas(128) std::unique_ptr<T*[]> slots;
+
+    public:
+        Queue(std::size_t max_threads = 2) : slots{new T*[CAPACITY]} {
+            (void) max_threads;
+        }
+
+        static std::string name() {
+            return "SPSC" + std::to_string(CAPACITY);
+        }
+
+        // Called by a thread that will not use the queue anymore
+        void release(std::size_t thread_id) {
+            (void) thread_id;
+        }
+
+        bool try_enqueue(T* item, std::size_t thread_id) {
+            (void) thread_id;
+            assert(item != nullptr && "Elemento a insertar no puede ser nulo");
+            uint64_t t = tail.load(std::memory_order_relaxed);
+            if (t - headCache >= CAPACITY) {
+                headCache = head.load(std::memory_order_acquire);
+                if (t - headCache >= CAPACITY) return false;
+            }
+            slots[t & MASK] = item;
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        using ThreadRegistration<Queue>::enqueue;
+        using ThreadRegistration<Queue>::dequeue;
+        using ThreadRegistration<Queue>::approx_size;
+
+        void enqueue(T* item, std::size_t thread_id) {
+            while (!try_enqueue(item, thread_id)) cpu_relax();
+        }
+
+        T* dequeue(std::size_t thread_id) {
+            (void) thread_id;
+            if (next == tailCache) {
+                tailCache = tail.load(std::memory_order_acquire);
+                if (next == tailCache) {
+                    // Gives back the slots of an unfinished batch
+                    if (head.load(std::memory_order_relaxed) != next) {
+                        head.store(next, std::memory_order_release);
+                    }
+                    return nullptr;
+                }
+            }
+            T* item = slots[next & MASK];
+            next++;
+            if (next % BATCH == 0) head.store(next, std::memory_order_release);
+            return item;
+        }
+
+        // Items between the published indices. head lags behind the
+        // consumer by less than BATCH items, and the result is off by
+        // the operations running concurrently.
+        std::size_t approx_size(std::size_t thread_id) {
+            (void) thread_id;
+            uint64_t h = head.load();
+            uint64_t t = tail.load();
+            return t > h ? t - h : 0;
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef _Thread_Handle_HPP_
+#define _Thread_Handle_HPP_
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+
+// Registration of the threads of a queue. Every operation of the
+// queues takes a thread id that indexes their per-thread state
+// (hazard pointers, protectors, handles...), and the ids must be
+// dense and below the number of threads given to the queue.
+// register_thread() chooses the id instead of the caller:
+
+// - ThreadIds gives the lowest id not in use (a bitmap scanned with
+//   fetch&or), so the ids stay below the number of threads using the
+//   queue at the same time, however many threads come and go.
+// - ThreadHandle owns one id. When it is destroyed (the thread leaves
+//   the queue) it calls release(id) on the queue, if the queue has
+//   one, and gives the id back, so the next thread reuses its rows
+//   instead of growing them.
+// - The operations that take the handle receive handle.ref(): the id,
+//   or the Ref of the queue (see thread_ref below), which also
+//   carries the address of the row of the thread, taken once at
+//   registration instead of on every operation.
+// - ThreadRegistration gives a queue register_thread() and those
+//   operations.
+
+// A thread keeps its handle for as long as it uses the queue, for
+// instance in a thread_local variable:
+
+//     thread_local auto handle = queue.register_thread();
+//     queue.enqueue(item, handle);
+
+// The queue must outlive the handles.
+
+class ThreadIds {
+private:
+    static const int WORDS = 64;
+
+    std::atomic<uint64_t> used[WORDS]{};
+
+public:
+    static const int MAX_IDS = WORDS * 64;
+
+    int acquire() {
+        for (int w = 0; w < WORDS; w++) {
+            uint64_t bits = used[w].load();
+            while (~bits != 0) {
+                uint64_t bit = 1ull << std::countr_one(bits);
+                bits = used[w].fetch_or(bit);
+                if ((bits & bit) == 0) return w * 64 + std::countr_zero(bit);
+            }
+        }
+        assert(false && "No quedan identificadores de hilo libres");
+        return -1;
+    }
+
+    void release(int id) {
+        used[id / 64].fetch_and(~(1ull << (id % 64)));
+    }
+};
+
+// What the operations of obj receive to identify the thread: the
+// Ref given by obj.thread_ref(id) when obj keeps its per-thread state
+// in a ThreadRegistry (MemoryManagementPool, SBQ, YMC), the id otherwise.
+template<typename T>
+auto thread_ref(T& obj, int id) {
+    if constexpr (requires { obj.thread_ref(id); }) {
+        return obj.thread_ref(id);
+    } else {
+        return id;
+    }
+}
+
+template<typename T>
+using thread_ref_t = decltype(thread_ref(std::declval<T&>(), 0));
+
+template<typename Queue>
+class ThreadHandle {
+private:
+    using Ref = thread_ref_t<Queue>;
+
+    Queue* queue;
+    ThreadIds* ids;
+    int tid;
+    Ref tref;
+
+public:
+    ThreadHandle(Queue& queue, ThreadIds& ids) :
+        queue{&queue}, ids{&ids}, tid{ids.acquire()}, tref{thread_ref(queue, tid)} {}
+
+    ThreadHandle(const ThreadHandle&) = delete;
+    ThreadHandle& operator=(const ThreadHandle&) = delete;
+
+    ThreadHandle(ThreadHandle&& other) :
+        queue{std::exchange(other.queue, nullptr)}, ids{other.ids}, tid{other.tid}, tref{other.tref} {}
+
+    ThreadHandle& operator=(ThreadHandle&& other) {
+        if (this != &other) {
+            reset();
+            queue = std::exchange(other.queue, nullptr);
+            ids = other.ids;
+            tid = other.tid;
+            tref = other.tref;
+        }
+        return *this;
+    }
+
+    ~ThreadHandle() {
+        reset();
+    }
+
+    int id() const {
+        return tid;
+    }
+
+    Ref ref() const {
+        return tref;
+    }
+
+    // Leaves the queue, the handle can not be used anymore
+    void reset() {
+        if (queue == nullptr) return;
+        if constexpr (requires { queue->release(tid); }) {
+            queue->release(tid);
+        }
+        ids->release(tid);
+        queue = nullptr;
+    }
+};
+
+template<typename Handle, typename Queue>
+concept handle_of = std::same_as<Handle, ThreadHandle<Queue>>;
+
+// Base of the queues (CRTP) that gives them register_thread() and the
+// operations that take a handle. The queue brings them next to its own
+// with
+//     using ThreadRegistration<Queue>::enqueue;
+//     using ThreadRegistration<Queue>::dequeue;
+// and the same for approx_size, enqueue_bulk and dequeue_bulk when it
+// has them.
+template<typename Queue>
+class ThreadRegistration {
+private:
+    ThreadIds threadIds;
+
+    Queue& self() {
+        return static_cast<Queue&>(*this);
+    }
+
+public:
+    // Registers the calling thread
+    ThreadHandle<Queue> register_thread() {
+        return ThreadHandle<Queue>(self(), threadIds);
+    }
+
+    template<typename V>
+    decltype(auto) enqueue(V item, ThreadHandle<Queue>& handle) {
+        return self().enqueue(item, handle.ref());
+    }
+
+    decltype(auto) dequeue(ThreadHandle<Queue>& handle) {
+        return self().dequeue(handle.ref());
+    }
+
+    // Only when the queue has them, so requires-expressions on the
+    // queue still tell. The handle is a constrained template parameter
+    // to reject other arguments before looking at the queue (which
+    // would find these same members again).
+    template<handle_of<Queue> Handle>
+    decltype(auto) approx_size(Handle& handle)
+        requires requires (Queue& queue, thread_ref_t<Queue> ref) { queue.approx_size(ref); } {
+        return self().approx_size(handle.ref());
+    }
+
+    template<typename Items, handle_of<Queue> Handle>
+    decltype(auto) enqueue_bulk(Items items, Handle& handle)
+        requires requires (Queue& queue, thread_ref_t<Queue> ref) { queue.enqueue_bulk(items, ref); } {
+        return self().enqueue_bulk(items, handle.ref());
+    }
+
+    template<typename Items, handle_of<Queue> Handle>
+    decltype(auto) dequeue_bulk(Items items, std::size_t max, Handle& handle)
+        requires requires (Queue& queue, thread_ref_t<Queue> ref) { queue.dequeue_bulk(items, max, ref); } {
+        return self().dequeue_bulk(items, max, handle.ref());
+    }
+};
+
+#endif
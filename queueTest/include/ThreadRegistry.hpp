@@ -0,0 +1,133 @@
+#ifndef _Thread_Registry_HPP_
+#define _Thread_Registry_HPP_
+
+#include <atomic>
+#include <cassert>
+
+
+// Per-thread rows of state indexed by thread id, for the structures
+// that scan the state of every thread (hazard pointers, protectors).
+
+// - Rows are allocated in chunks of CHUNK_SIZE on the first use of an
+//   id of the chunk, so there is no fixed limit of 64 threads (the
+//   limit is CHUNK_SIZE * CHUNKS_MAX ids) and no memory for ids that
+//   are never used.
+// - get(thread_id) registers the row: it is marked active and, the
+//   first time, pushed to the live list. Scans (forEachLive) only
+//   visit the rows in that list, so their cost follows the threads
+//   that actually used the structure.
+// - release(thread_id) marks the row inactive when the thread
+//   exits. The row stays in the list (rows are never freed before the
+//   registry) and is reused if the id registers again.
+
+// The active flag is written with seq_cst, so a thread that registers
+// again while a scan skips its row can only publish something after
+// the scan has read the flag, as with a hazard pointer.
+
+// A Ref is a thread id that may carry the address of its row, taken
+// once by ref(thread_id) when the thread registers (ThreadHandle
+// keeps it). get(Ref) then skips the lookup of the chunk. A Ref built
+// from a plain id looks the row up as get(int) does.
+
+template<typename Row>
+class ThreadRegistry {
+private:
+    static const int CHUNK_SIZE = 64;
+    static const int CHUNKS_MAX = 64;
+
+    struct Entry {
+        Row row{};
+        std::atomic<bool> active{false};
+        bool listed{false};
+        Entry* next{nullptr};
+    };
+
+    std::atomic<Entry*> chunks[CHUNKS_MAX];
+    std::atomic<Entry*> live{nullptr};
+
+    Entry& entry(int thread_id) {
+        assert(thread_id >= 0 && thread_id < CHUNK_SIZE * CHUNKS_MAX && "Identificador de hilo fuera de rango");
+        std::atomic<Entry*>& slot = chunks[thread_id / CHUNK_SIZE];
+        Entry* chunk = slot.load(std::memory_order_acquire);
+        if (chunk == nullptr) {
+            Entry* newChunk = new Entry[CHUNK_SIZE];
+            if (slot.compare_exchange_strong(chunk, newChunk)) {
+                chunk = newChunk;
+            } else {
+                delete[] newChunk;
+            }
+        }
+        return chunk[thread_id % CHUNK_SIZE];
+    }
+
+    void activate(Entry& e) {
+        e.active.store(true, std::memory_order_seq_cst);
+        if (e.listed) return;
+        e.listed = true;
+        Entry* head = live.load();
+        do {
+            e.next = head;
+        } while (!live.compare_exchange_weak(head, &e));
+    }
+
+public:
+    struct Ref {
+        int id;
+        Row* row{nullptr};
+
+        Ref(int id) : id{id} {}
+        Ref(int id, Row* row) : id{id}, row{row} {}
+
+        operator int() const {
+            return id;
+        }
+    };
+
+    ThreadRegistry() {
+        for (int i = 0; i < CHUNKS_MAX; i++) {
+            chunks[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~ThreadRegistry() {
+        for (int i = 0; i < CHUNKS_MAX; i++) {
+            delete[] chunks[i].load();
+        }
+    }
+
+    Row& get(int thread_id) {
+        Entry& e = entry(thread_id);
+        if (!e.active.load(std::memory_order_relaxed)) activate(e);
+        return e.row;
+    }
+
+    Row& get(Ref ref) {
+        return ref.row != nullptr ? *ref.row : get(ref.id);
+    }
+
+    Ref ref(int thread_id) {
+        return Ref(thread_id, &get(thread_id));
+    }
+
+    void release(int thread_id) {
+        entry(thread_id).active.store(false, std::memory_order_release);
+    }
+
+    // Visits the rows of the threads registered now
+    template<typename F>
+    void forEachLive(F f) {
+        for (Entry* e = live.load(); e != nullptr; e = e->next) {
+            if (e->active.load()) f(e->row);
+        }
+    }
+
+    // Visits every row that has been registered at some point
+    template<typename F>
+    void forEach(F f) {
+        for (Entry* e = live.load(); e != nullptr; e = e->next) {
+            f(e->row);
+        }
+    }
+};
+
+#endif
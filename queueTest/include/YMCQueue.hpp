@@ -6,12 +6,15 @@
 #include <array>
 #include <limits>
 #include <vector>
-#include <deque>
+#include <memory>
+#include <mutex>
 #include <cassert>
-#include <iostream>
+#include "ThreadRegistry.hpp"
+#include "ThreadHandle.hpp"
 
 namespace ymc_queue {
     static constexpr auto PATIENCE = std::size_t{10};
+    static constexpr std::size_t SEGMENT_POOL_MAX = 16;
     static constexpr auto NO_HAZARD = std::numeric_limits<std::uintmax_t>::max();
     constexpr int NODE_POW = 10;
     constexpr std::size_t NODE_SIZE = 1ull << NODE_POW;
@@ -23,7 +26,7 @@ namespace ymc_queue {
     }
 
     template<typename T>
-    class Queue {
+    class Queue : public ThreadRegistration<Queue<T>> {
     private:
 
         // Enqueue request
@@ -58,15 +61,14 @@ namespace ymc_queue {
             alignas(64) std::array<Cell, NODE_SIZE> cells{};
         };
 
+        // Handles are created on the first operation of each thread
+        // and inserted in the ring of next pointers used for helping.
+        // They are never removed.
         struct Handle {
-            Handle(Segment* segment, std::size_t maxThreads) :
-                tail{segment}, head{segment}, peerHandles{maxThreads} {
-                for (long unsigned int i = 0; i < maxThreads; i++) {
-                    this->peerHandles.push_back(nullptr);
-                }
-            }
+            Handle(Segment* segment) :
+                tail{segment}, tailNodeId(segment->id), head{segment}, headNodeId(segment->id) {}
 
-            Handle* next{nullptr};
+            std::atomic<Handle*> next{nullptr};
             std::atomic<uintmax_t> hzdNodeId{MAX_VAL};
             std::atomic<Segment*> tail;
             std::uintmax_t tailNodeId{0};
@@ -77,8 +79,26 @@ namespace ymc_queue {
             alignas(64) Handle* enqHelpHandle{nullptr};
             intmax_t Ei{0};
             Handle* deqHelpHandle{ nullptr };
-            Segment* spareNode{ new Segment() } ;
-            std::vector<Handle*> peerHandles;
+            Segment* spareNode{nullptr};
+            std::vector<Handle*> peerHandles; // Scan buffer of cleanUp
+        };
+
+        struct HandleSlot {
+            Handle* handle{nullptr};
+        };
+
+        // What thread_ref gives to the handles: the id and its Handle,
+        // so the operations do not look it up in mHandles
+        struct Thread {
+            std::size_t id;
+            Handle* handle{nullptr};
+
+            Thread(std::size_t id) : id{id} {}
+            Thread(std::size_t id, Handle* handle) : id{id}, handle{handle} {}
+
+            operator std::size_t() const {
+                return id;
+            }
         };
 
         struct FindCellResult {
@@ -91,9 +111,75 @@ namespace ymc_queue {
         alignas(128) std::atomic<intmax_t> mHelpIdx{0};
 
         std::atomic<Segment*> mHead;
-        std::deque<Handle*> mHandles;
+        std::atomic<Handle*> mRing{nullptr};
+        ThreadRegistry<HandleSlot> mHandles;
         std::size_t mMaxThreads;
 
+        // Segments freed by cleanUp, reused as spare segments by any
+        // handle. If the lock is taken the segment is deleted (or
+        // allocated) instead of waiting.
+        std::vector<Segment*> mSegmentPool;
+        std::mutex mSegmentPoolLock;
+
+        Segment* newSegment() {
+            Segment* segment = nullptr;
+            if (this->mSegmentPoolLock.try_lock()) {
+                if (!this->mSegmentPool.empty()) {
+                    segment = this->mSegmentPool.back();
+                    this->mSegmentPool.pop_back();
+                }
+                this->mSegmentPoolLock.unlock();
+            }
+            if (segment == nullptr) return new Segment();
+            std::destroy_at(segment);
+            std::construct_at(segment);
+            return segment;
+        }
+
+        void freeSegment(Segment* segment) {
+            if (this->mSegmentPoolLock.try_lock()) {
+                if (this->mSegmentPool.size() < SEGMENT_POOL_MAX) {
+                    this->mSegmentPool.push_back(segment);
+                    segment = nullptr;
+                }
+                this->mSegmentPoolLock.unlock();
+            }
+            delete segment;
+        }
+
+        // Registration takes the same flag as cleanUp (mHelpIdx = -1),
+        // so the head segment read here cannot be freed before the
+        // handle is in the ring, where cleanUp sees its hazards.
+        Handle* registerHandle() {
+            auto oid = this->mHelpIdx.load(std::memory_order_acquire);
+            while (oid == -1 || !this->mHelpIdx.compare_exchange_weak(oid, -1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                oid = this->mHelpIdx.load(std::memory_order_acquire);
+            }
+            Handle* handle = new Handle(this->mHead.load(std::memory_order_relaxed));
+            Handle* ring = this->mRing.load(std::memory_order_relaxed);
+            if (ring == nullptr) {
+                handle->next.store(handle, std::memory_order_relaxed);
+            } else {
+                handle->next.store(ring->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            handle->enqHelpHandle = handle->next.load(std::memory_order_relaxed);
+            handle->deqHelpHandle = handle->enqHelpHandle;
+            if (ring == nullptr) {
+                this->mRing.store(handle, std::memory_order_release);
+            } else {
+                ring->next.store(handle, std::memory_order_release);
+            }
+            this->mHelpIdx.store(oid, std::memory_order_release);
+            return handle;
+        }
+
+        Handle* handleOf(Thread thread_id) {
+            if (thread_id.handle != nullptr) return thread_id.handle;
+            HandleSlot& slot = this->mHandles.get(thread_id.id);
+            if (slot.handle == nullptr) slot.handle = registerHandle();
+            return slot.handle;
+        }
+
         Segment* check(const std::atomic<uintmax_t>& peerHzdNodeId, Segment* curr, Segment* old) {
             const auto hzdNodeId = peerHzdNodeId.load(std::memory_order_acquire);
             if (hzdNodeId < (const long unsigned int)curr->id) {
@@ -133,7 +219,7 @@ namespace ymc_queue {
                     auto tmp = threadHandle.spareNode;
 
                     if (tmp == nullptr) {
-                        tmp = new Segment();
+                        tmp = newSegment();
                         threadHandle.spareNode = tmp;
                     }
                     tmp->id = j + 1;
@@ -148,26 +234,11 @@ namespace ymc_queue {
         }
 
     public:
-        Queue(std::size_t max_threads) : mHandles{}, mMaxThreads(max_threads)
+        Queue(std::size_t max_threads) : mMaxThreads(max_threads)
         {
             assert(max_threads > 0 && "Max_threads must be at least 1");
             Segment* node = new Segment();
             this->mHead.store(node, std::memory_order_relaxed);
-            for (std::size_t i = 0; i < max_threads; ++i) {
-                this->mHandles.push_back(new Handle(node, max_threads));
-                // this->mHandles.emplace_back(node, max_threads);
-            }
-
-            for (std::size_t i = 0; auto& handle : this->mHandles) {
-                auto next = i == max_threads - 1
-                    ? this->mHandles[0]
-
-                    : this->mHandles[i + 1];
-                handle->next = next;
-                handle->enqHelpHandle = next;
-                handle->deqHelpHandle = next;
-                i++;
-            }
         }
 
         ~Queue() {
@@ -177,14 +248,27 @@ namespace ymc_queue {
                 curr = curr->next.load(std::memory_order_relaxed);
                 delete tmp;
             }
-            for (auto& handle : this->mHandles) {
-                delete handle->spareNode;
-                delete handle;
+            this->mHandles.forEach([](HandleSlot& slot) {
+                if (slot.handle == nullptr) return;
+                delete slot.handle->spareNode;
+                delete slot.handle;
+            });
+            for (Segment* segment : this->mSegmentPool) {
+                delete segment;
             }
         }
 
-        void enqueue(T* elem, std::size_t thread_id) {
-            auto th = this->mHandles[thread_id];
+        using ThreadRegistration<Queue>::enqueue;
+        using ThreadRegistration<Queue>::dequeue;
+        using ThreadRegistration<Queue>::approx_size;
+
+        // Called once by the handle of a thread, see ThreadHandle.hpp
+        Thread thread_ref(const int thread_id) {
+            return Thread(thread_id, handleOf(thread_id));
+        }
+
+        void enqueue(T* elem, Thread thread_id) {
+            auto th = handleOf(thread_id);
             th->hzdNodeId.store(th->tailNodeId, std::memory_order_relaxed);
             std::intmax_t id = 0;
             bool success = false;
@@ -203,8 +287,13 @@ namespace ymc_queue {
             th->hzdNodeId.store(NO_HAZARD, std::memory_order_release);
         }
 
-        T* dequeue(std::size_t thread_id) {
-            auto th = this->mHandles[thread_id];
+        T* dequeue(Thread thread_id) {
+            // Read-only empty check: mDeqIdx is read first, so if every
+            // cell index was already given to a dequeuer the queue was
+            // empty when mEnqIdx was read. Polling an empty queue then
+            // does not fetch&add mDeqIdx nor mark cells.
+            if (this->mDeqIdx.load() >= this->mEnqIdx.load()) return nullptr;
+            auto th = handleOf(thread_id);
             th->hzdNodeId.store(th->headNodeId, std::memory_order_relaxed);
             std::intmax_t id = 0;
             T* res = nullptr;
@@ -228,12 +317,23 @@ namespace ymc_queue {
 
             if (th->spareNode == nullptr) {
                 this->cleanUp(*th);
-                th->spareNode = new Segment();
+                th->spareNode = newSegment();
             }
 
             return res;
         }
 
+        // Difference of the global indices, two loads and no write.
+        // Exact when no operation is running, otherwise off by at
+        // most the number of concurrent operations. Indices burnt by
+        // dequeues on an empty queue or by the slow paths make it an
+        // overestimate until the enqueuers pass them.
+        std::size_t approx_size(std::size_t thread_id) {
+            (void) thread_id;
+            auto lDi = this->mDeqIdx.load(std::memory_order_relaxed);
+            auto lEi = this->mEnqIdx.load(std::memory_order_relaxed);
+            return lEi > lDi ? lEi - lDi : 0;
+        }
 
         void cleanUp(Handle& th) {
             auto oid = this->mHelpIdx.load(std::memory_order_acquire);
@@ -258,19 +358,19 @@ namespace ymc_queue {
 
             auto oldNode = this->mHead.load(std::memory_order_relaxed);
             auto ph = &th;
-            auto i = 0;
+            th.peerHandles.clear();
 
             do {
                 newNode = check(ph->hzdNodeId, newNode, oldNode);
                 newNode = update(ph->tail, ph->hzdNodeId, newNode, oldNode);
                 newNode = update(ph->head, ph->hzdNodeId, newNode, oldNode);
 
-                th.peerHandles[i++] = ph;
-                ph = ph->next;
+                th.peerHandles.push_back(ph);
+                ph = ph->next.load(std::memory_order_acquire);
             } while (newNode->id > oid && ph != &th);
 
-            while (newNode->id > oid && --i >= 0) {
-                newNode = check(th.peerHandles[i]->hzdNodeId, newNode, oldNode);
+            for (auto it = th.peerHandles.rbegin(); newNode->id > oid && it != th.peerHandles.rend(); ++it) {
+                newNode = check((*it)->hzdNodeId, newNode, oldNode);
             }
 
             const std::atomic_intmax_t nid{newNode->id.load()};
@@ -282,7 +382,7 @@ namespace ymc_queue {
 
                 while (oldNode != newNode) {
                     auto tmp = oldNode->next.load(std::memory_order_relaxed);
-                    delete oldNode;
+                    freeSegment(oldNode);
                     oldNode = tmp;
                 }
             }
@@ -313,7 +413,6 @@ namespace ymc_queue {
             do {
                 i = this->mEnqIdx.fetch_add(1, std::memory_order_relaxed);
                 auto [cell, _ignore] = findCell(threadHandle.tail, threadHandle, i);
-                std::cout << &enq << "\n" ;
                 EnqReq* expected = nullptr;
                 if (
                     cell.enqReq.compare_exchange_strong(expected, &enq, std::memory_order_seq_cst, std::memory_order_seq_cst)
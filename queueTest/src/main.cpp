@@ -52,6 +52,22 @@ int main() {
     // std::cout << time << std::endl;
     // std::cout << "\nEjecutando enqueues-dequeues\n";
     // experiments::experiments();
+    // std::cout << "\nEjecutando combinaciones de la cola modular\n";
+    // experiments::experiments_modular();
+    // std::cout << "\nEjecutando latencia de despertar\n";
+    // experiments::experiments_wakeup();
+    // std::cout << "\nEjecutando comparación de recolección de memoria\n";
+    // experiments::experiments_reclamation();
+    // std::cout << "\nEjecutando barrido de políticas de backoff\n";
+    // experiments::experiments_backoff();
+    // std::cout << "\nEjecutando sondeo de colas vacías\n";
+    // experiments::experiments_empty_polling();
+    // std::cout << "\nEjecutando productores/consumidores separados\n";
+    // experiments::experiments_roles();
+    // std::cout << "\nEjecutando enlace de un productor y un consumidor\n";
+    // experiments::experiments_spsc();
+    // std::cout << "\nEjecutando colas intrusivas\n";
+    // experiments::experiments_intrusive();
     std::cout << "\nEjecutando sólo enqueues\n";
     experiments::experiments_only_enq();
     std::cout << "\nEjecutando sólo dequeues\n";
@@ -138,3 +138,214 @@ TEST_F(TestQueue, allEnqueued)
     }
     EXPECT_EQ(totalEnqueued, operations);
 }
+
+TEST_F(TestQueue, isEnqueueAndDequeueFusedFAI)
+{
+    // Monolithic version of FAIQueue<LLICCAS>, with baskets of size 1
+    FusedFAIQueue queue{10000000, 1, 1};
+    for(int i = 0; i < 10000000; i++) {
+        queue.enqueue(i, 0);
+    }
+    for(int i = 0; i < 10000000; i++) {
+        EXPECT_EQ(queue.dequeue(0), i);
+    }
+    EXPECT_EQ(queue.dequeue(0), EMPTY);
+}
+
+TEST_F(TestQueue, allEnqueuedFusedFAI)
+{
+    const auto cores = std::thread::hardware_concurrency();
+    const auto operations = 100'000;
+    int k = (int) std::sqrt(cores) + 1;
+    FusedFAIQueue queue{operations, k, (int) cores};
+    std::vector<std::thread> threads;
+    int totalOps = operations / cores;
+    auto wait_for_begin = [] () noexcept {};
+    std::barrier sync_points(cores, wait_for_begin);
+    std::function<void(int)> func = [&](int processId) {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> distrib(1, 3);
+        sync_points.arrive_and_wait();
+        for (int i = 0; i < totalOps; i++) {
+            queue.enqueue(distrib(gen), processId);
+            for (int j = 0; j < 60; j = j + distrib(gen)) {}
+        }
+    };
+    for (unsigned i = 0; i < cores; i++) {
+        threads.emplace_back(func, i);
+    }
+    for (std::thread &th : threads) {
+        if (th.joinable()) th.join();
+    }
+
+    int totalEnqueued = 0;
+    while (queue.dequeue(0) != EMPTY) {
+        totalEnqueued++;
+    }
+    EXPECT_EQ(totalEnqueued, (int) (totalOps * cores));
+}
+
+TEST_F(TestQueue, isEnqueueAndDequeueSegmentedFAI)
+{
+    // Unbounded version of FAIQueue<LLICCAS>, it grows by segments
+    // of baskets instead of preallocating the capacity
+    SegmentedFAIQueue<LLICCAS64> queue{1, 1};
+    for(int i = 0; i < 10000000; i++) {
+        queue.enqueue(i, 0);
+    }
+    for(int i = 0; i < 10000000; i++) {
+        EXPECT_EQ(queue.dequeue(0), i);
+    }
+    EXPECT_EQ(queue.dequeue(0), EMPTY);
+}
+
+TEST_F(TestQueue, isEnqueueAndDequeueSegmentedCAS)
+{
+    SegmentedCASQueue<LLICRW> queue{1};
+    for (int round = 0; round < 10; round++) {
+        for(int i = 0; i < 1000000; i++) {
+            queue.enqueue(i, 0);
+        }
+        for(int i = 0; i < 1000000; i++) {
+            EXPECT_EQ(queue.dequeue(0), i);
+        }
+        EXPECT_EQ(queue.dequeue(0), EMPTY);
+    }
+}
+
+TEST_F(TestQueue, allDequeuedSegmentedFAI)
+{
+    const auto cores = std::thread::hardware_concurrency();
+    const auto operations = 1'000'000;
+    int k = (int) std::sqrt(cores) + 1;
+    SegmentedFAIQueue<LLICCAS64> queue{k, (int) cores};
+    std::vector<std::thread> threads;
+    int totalOps = operations / cores;
+    std::atomic<int> totalDequeued{0};
+    auto wait_for_begin = [] () noexcept {};
+    std::barrier sync_points(cores, wait_for_begin);
+    std::function<void(int)> func = [&](int processId) {
+        sync_points.arrive_and_wait();
+        for (int i = 0; i < totalOps; i++) {
+            queue.enqueue(i, processId);
+            if (queue.dequeue(processId) != EMPTY) totalDequeued++;
+        }
+    };
+    for (unsigned i = 0; i < cores; i++) {
+        threads.emplace_back(func, i);
+    }
+    for (std::thread &th : threads) {
+        if (th.joinable()) th.join();
+    }
+
+    while (queue.dequeue(0) != EMPTY) {
+        totalDequeued++;
+    }
+    EXPECT_EQ(totalDequeued.load(), (int) (totalOps * cores));
+}
+
+TEST_F(TestQueue, isFullCircularFAI)
+{
+    // Ring of 1024 baskets of size 1, it is filled and drained many
+    // times to reuse every basket
+    CircularFAIQueue<LLICCAS64> queue{1024, 1, 1};
+    for (int lap = 0; lap < 1000; lap++) {
+        for (int i = 0; i < 1024; i++) {
+            EXPECT_EQ(queue.enqueue(i, 0), OK);
+        }
+        EXPECT_EQ(queue.enqueue(1024, 0), FULL);
+        for (int i = 0; i < 1024; i++) {
+            EXPECT_EQ(queue.dequeue(0), i);
+        }
+        EXPECT_EQ(queue.dequeue(0), EMPTY);
+    }
+}
+
+TEST_F(TestQueue, allDequeuedCircularFAI)
+{
+    const auto cores = std::thread::hardware_concurrency();
+    const auto operations = 1'000'000;
+    int k = (int) std::sqrt(cores) + 1;
+    CircularFAIQueue<LLICCAS64> queue{1024, k, (int) cores};
+    std::vector<std::thread> threads;
+    int totalOps = operations / cores;
+    std::atomic<int> totalEnqueued{0};
+    std::atomic<int> totalDequeued{0};
+    auto wait_for_begin = [] () noexcept {};
+    std::barrier sync_points(cores, wait_for_begin);
+    std::function<void(int)> func = [&](int processId) {
+        sync_points.arrive_and_wait();
+        for (int i = 0; i < totalOps; i++) {
+            if (queue.enqueue(i, processId) == OK) totalEnqueued++;
+            if (queue.dequeue(processId) != EMPTY) totalDequeued++;
+        }
+    };
+    for (unsigned i = 0; i < cores; i++) {
+        threads.emplace_back(func, i);
+    }
+    for (std::thread &th : threads) {
+        if (th.joinable()) th.join();
+    }
+
+    while (queue.dequeue(0) != EMPTY) {
+        totalDequeued++;
+    }
+    EXPECT_EQ(totalDequeued.load(), totalEnqueued.load());
+}
+
+TEST_F(TestQueue, isEnqueueAndDequeueBulkFAI)
+{
+    // Batches of 100 items in baskets of size 8, dequeued in batches
+    // of 64 items
+    FAIQueue<LLICCAS> queue{200000, 8, 1};
+    std::vector<int> batch(100);
+    for (int i = 0; i < 1000000; i += 100) {
+        for (int j = 0; j < 100; j++) batch[j] = i + j;
+        queue.enqueue_bulk(batch, 0);
+    }
+    std::vector<int> out(100);
+    int expected = 0;
+    while (expected < 1000000) {
+        int n = queue.dequeue_bulk(out, 64, 0);
+        ASSERT_GT(n, 0);
+        for (int j = 0; j < n; j++) {
+            EXPECT_EQ(out[j], expected++);
+        }
+    }
+    EXPECT_EQ(queue.dequeue_bulk(out, 64, 0), 0);
+}
+
+TEST_F(TestQueue, allDequeuedBulkSegmentedFAI)
+{
+    const auto cores = std::thread::hardware_concurrency();
+    const auto operations = 1'000'000;
+    SegmentedFAIQueue<LLICCAS64> queue{16, (int) cores};
+    std::vector<std::thread> threads;
+    int totalOps = operations / cores / 100;
+    std::atomic<int> totalDequeued{0};
+    auto wait_for_begin = [] () noexcept {};
+    std::barrier sync_points(cores, wait_for_begin);
+    std::function<void(int)> func = [&](int processId) {
+        std::vector<int> batch(100, processId);
+        std::vector<int> out(100);
+        sync_points.arrive_and_wait();
+        for (int i = 0; i < totalOps; i++) {
+            queue.enqueue_bulk(batch, processId);
+            totalDequeued += queue.dequeue_bulk(out, 50, processId);
+        }
+    };
+    for (unsigned i = 0; i < cores; i++) {
+        threads.emplace_back(func, i);
+    }
+    for (std::thread &th : threads) {
+        if (th.joinable()) th.join();
+    }
+
+    std::vector<int> out(100);
+    int n;
+    while ((n = queue.dequeue_bulk(out, 100, 0)) > 0) {
+        totalDequeued += n;
+    }
+    EXPECT_EQ(totalDequeued.load(), (int) (totalOps * cores * 100));
+}